@@ -86,6 +86,15 @@ if [ -f "version_4_8/build/tournament" ]; then
         echo -e "${RED}Файл test_letters_incorrect.txt не найден${NC}"
     fi
 
+    echo ""
+    echo "Тест 5 (остановка по SIGINT с дренажом боев)"
+    ./tournament 16 -seed 5 -drain-ms 2000 > signal_4_8.txt &
+    TOURNAMENT_PID=$!
+    sleep 4
+    kill -INT $TOURNAMENT_PID
+    wait $TOURNAMENT_PID && grep "дренаж занял" signal_4_8.txt
+    check_exit_code
+
     cd "$BASE_DIR"
 else
     echo -e "${RED}Файл version_4_8/build/tournament не найден${NC}"
@@ -122,11 +131,105 @@ if [ -f "version_9_10/build/tournament" ]; then
     fi
 
     echo ""
-    echo "Тест 4 (некорректный, 50 бойцов, из командной строки)"
+    echo "Тест 4 (некорректный, 50 бойцов для движка threads, из командной строки)"
     echo "Ожидается сообщение об ошибке:"
-    ./tournament 50 2>&1 | tee error_9_10_50.txt | head -5
+    ./tournament 50 -engine threads 2>&1 | tee error_9_10_50.txt | head -5
+    check_exit_code
+
+    echo ""
+    echo "Тест 5 (запись событий 8 бойцов и проверка через -replay)"
+    ./tournament 8 -seed 7 -rec record_9_10_8.bin > /dev/null && \
+        ./tournament -replay record_9_10_8.bin | tee replay_9_10_8.txt
+    [ "${PIPESTATUS[0]}" -eq 0 ]  # код replay, а не tee
+    check_exit_code
+
+    echo ""
+    echo "Тест 6 (движок coro: порции боев на пуле, 100000 бойцов на 4 рабочих потоках)"
+    ./tournament 100000 -seed 7 -workers 4 -rec record_9_10_coro.bin > /dev/null && \
+        ./tournament -replay record_9_10_coro.bin | tail -1
+    [ "${PIPESTATUS[0]}" -eq 0 ]  # код replay, а не tail
+    check_exit_code
+
+    echo ""
+    echo "Тест 7 (пакетный режим, турниры из файла)"
+    if [ -f "../test_batch_correct.txt" ]; then
+        ./tournament -batch ../test_batch_correct.txt -o results_9_10_batch.txt -quiet
+        check_exit_code
+    else
+        echo -e "${RED}Файл test_batch_correct.txt не найден${NC}"
+    fi
+
+    echo ""
+    echo "Тест 8 (хранилище результатов, запрос истории бойца)"
+    rm -rf store_9_10
+    ./tournament 8 -seed 1 -store store_9_10 -quiet && \
+        ./tournament 16 -seed 2 -engine coro -store store_9_10 -quiet && \
+        ./tournament -query store_9_10 3 > query_9_10.txt && \
+        ./tournament -query store_9_10 3 -last 1 >> query_9_10.txt
+    check_exit_code
+
+    echo ""
+    echo "Тест 9 (смешанные стратегии бойцов, проверка записи)"
+    if [ -f "../test_strategies.txt" ]; then
+        ./tournament 10000 -engine coro -seed 9 -strategies ../test_strategies.txt \
+            -rec record_9_10_strategies.bin -o results_9_10_strategies.txt -quiet && \
+            ./tournament -replay record_9_10_strategies.bin
+        check_exit_code
+    else
+        echo -e "${RED}Файл test_strategies.txt не найден${NC}"
+    fi
+
+    echo ""
+    echo "Тест 10 (нет выделений в куче во время раундов)"
+    ./tournament 100000 -engine coro -seed 10 -o results_9_10_alloc.txt -quiet && \
+        grep "выделений в куче во время раундов: 0$" results_9_10_alloc.txt
     check_exit_code
 
+    echo ""
+    echo "Тест 11 (остановка по SIGINT с дренажом боев)"
+    ./tournament 16 -seed 11 -engine threads -drain-ms 2000 > signal_9_10.txt &
+    TOURNAMENT_PID=$!
+    sleep 4
+    kill -INT $TOURNAMENT_PID
+    wait $TOURNAMENT_PID && grep "дренаж занял" signal_9_10.txt
+    check_exit_code
+
+    echo ""
+    echo "Тест 12 (время до первого боя для 1000000 бойцов)"
+    ./tournament 1000000 -engine coro -seed 12 -o results_9_10_startup.txt -quiet && \
+        grep "Время до первого боя" results_9_10_startup.txt
+    check_exit_code
+
+    echo ""
+    echo "Тест 13 (статистика конкуренции -stats, нагрузочный прогон — tests/stress.sh)"
+    ./tournament 10000 -engine coro -workers 8 -seed 13 -stats -o results_9_10_stats.txt -quiet && \
+        grep "^Статистика:\|^Ожидание блокировки" results_9_10_stats.txt
+    check_exit_code
+
+    echo ""
+    echo "Тест 14 (малая сетка: движок small совпадает с движком threads)"
+    ./tournament 8 -seed 14 -rec record_9_10_small.bin -o results_9_10_small.txt -quiet && \
+        ./tournament 8 -seed 14 -engine threads -rec record_9_10_threads.bin \
+            -o results_9_10_small_threads.txt -quiet && \
+        cmp <(grep "^Начало раунда\|^Организован бой" results_9_10_small.txt) \
+            <(grep "^Начало раунда\|^Организован бой" results_9_10_small_threads.txt) && \
+        cmp <(od -An -tx1 -w16 -v record_9_10_small.bin | grep -v "^ 04") \
+            <(od -An -tx1 -w16 -v record_9_10_threads.bin | grep -v "^ 04") && \
+        cmp <(od -An -tx1 -w16 -v record_9_10_small.bin | grep "^ 04" | sort) \
+            <(od -An -tx1 -w16 -v record_9_10_threads.bin | grep "^ 04" | sort) && \
+        grep "Победитель: " results_9_10_small.txt
+    check_exit_code
+
+    echo ""
+    echo "Тест 15 (пакетный режим, некорректные спецификации турниров)"
+    if [ -f "../test_batch_incorrect.txt" ]; then
+        ./tournament -batch ../test_batch_incorrect.txt -quiet > error_9_10_batch.txt
+        [ $? -eq 1 ] && grep "с ошибками 5," error_9_10_batch.txt  # все строки отвергнуты
+        check_exit_code
+    else
+        echo -e "${RED}Файл test_batch_incorrect.txt не найден${NC}"
+    fi
+
     cd "$BASE_DIR"
 else
     echo -e "${RED}Файл version_9_10/build/tournament не найден${NC}"
@@ -139,7 +242,19 @@ echo "- version_4_8/build/results_4_8_8.txt"
 echo "- version_4_8/build/results_4_8_16.txt"
 echo "- version_4_8/build/error_4_8_-3.txt"
 echo "- version_4_8/build/error_4_8_letters.txt"
+echo "- version_4_8/build/signal_4_8.txt"
 echo "- version_9_10/build/results_9_10_4.txt"
 echo "- version_9_10/build/results_9_10_32.txt"
 echo "- version_9_10/build/error_9_10_0.txt"
 echo "- version_9_10/build/error_9_10_50.txt"
+echo "- version_9_10/build/error_9_10_batch.txt"
+echo "- version_9_10/build/replay_9_10_8.txt"
+echo "- version_9_10/build/results_9_10_batch.txt"
+echo "- version_9_10/build/query_9_10.txt"
+echo "- version_9_10/build/results_9_10_strategies.txt"
+echo "- version_9_10/build/results_9_10_alloc.txt"
+echo "- version_9_10/build/signal_9_10.txt"
+echo "- version_9_10/build/results_9_10_startup.txt"
+echo "- version_9_10/build/results_9_10_stats.txt"
+echo "- version_9_10/build/results_9_10_small.txt"
+echo "- version_9_10/build/results_9_10_small_threads.txt"
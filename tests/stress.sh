@@ -0,0 +1,159 @@
+#!/bin/bash
+
+# нагрузочный прогон движков при переподписке (потоков намного больше, чем ядер):
+# статистика -stats сравнивается с порогами, затем сборки с ThreadSanitizer
+# пороги и ограничение CPU задаются переменными окружения
+
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+NC='\033[0m'
+
+STRESS_CPUS=${STRESS_CPUS:-1}  # ядер для прогона (taskset)
+STRESS_CPU_MAX=${STRESS_CPU_MAX:-}  # квота cgroup v2 cpu.max, например "50000 100000"
+MIN_DUELS_CORO=${MIN_DUELS_CORO:-200000}  # боев/с движка coro
+MIN_DUELS_THREADS=${MIN_DUELS_THREADS:-1.5}  # боев/с движков "поток на бойца" (раунд — пауза 2 с)
+MAX_ROUND_MS_CORO=${MAX_ROUND_MS_CORO:-3000}  # самый долгий раунд движка coro
+MAX_ROUND_MS_THREADS=${MAX_ROUND_MS_THREADS:-8000}  # самый долгий раунд движков с потоками
+MAX_LOCK_WAIT_P99_US=${MAX_LOCK_WAIT_P99_US:-100000}  # p99 ожидания среди ждавших захватов
+MAX_LOCK_WAIT_US=${MAX_LOCK_WAIT_US:-250000}  # самое долгое ожидание любой блокировки
+MAX_STALLED_ROUNDS=${MAX_STALLED_ROUNDS:-0}  # раундов, брошенных по max_waits
+
+FAILED=0
+
+BASE_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+echo "Рабочая директория: $BASE_DIR"
+cd "$BASE_DIR"
+
+# ограничение CPU: taskset на STRESS_CPUS ядер и, если задано, квота cgroup
+LIMIT=()
+if command -v taskset > /dev/null; then
+    LIMIT=(taskset -c "0-$((STRESS_CPUS - 1))")
+fi
+CGROUP_DIR=""
+if [ -n "$STRESS_CPU_MAX" ]; then
+    CGROUP_DIR="/sys/fs/cgroup/tournament_stress_$$"
+    # cgroup.procs создает ядро: без него каталог не является cgroup
+    if mkdir "$CGROUP_DIR" 2> /dev/null && [ -f "$CGROUP_DIR/cgroup.procs" ] && \
+            echo "$STRESS_CPU_MAX" > "$CGROUP_DIR/cpu.max" 2> /dev/null; then
+        trap 'rmdir "$CGROUP_DIR" 2> /dev/null' EXIT
+    else
+        echo -e "${RED}Не удалось создать cgroup с cpu.max, прогон без квоты${NC}"
+        rmdir "$CGROUP_DIR" 2> /dev/null
+        CGROUP_DIR=""
+    fi
+fi
+
+# запуск команды с ограничением CPU
+run_limited() {
+    if [ -n "$CGROUP_DIR" ]; then
+        bash -c 'echo $$ > "$1/cgroup.procs" && shift && exec "$@"' _ "$CGROUP_DIR" "${LIMIT[@]}" "$@"
+    else
+        "${LIMIT[@]}" "$@"
+    fi
+}
+
+# сборка версии в отдельный каталог с дополнительными параметрами cmake
+build() {
+    local dir=$1
+    shift
+    cmake -S "$BASE_DIR/${dir%%/*}" -B "$BASE_DIR/$dir" "$@" > /dev/null && \
+        cmake --build "$BASE_DIR/$dir" > /dev/null
+}
+
+# сравнение значения с порогом: check ИМЯ ЗНАЧЕНИЕ min|max ПОРОГ
+check() {
+    local name=$1 value=$2 kind=$3 limit=$4
+    if [ -z "$value" ]; then
+        echo -e "${RED}$name: нет значения в выводе${NC}"
+        FAILED=1
+    elif awk -v v="$value" -v l="$limit" -v k="$kind" \
+            'BEGIN { exit !((k == "min" && v >= l) || (k == "max" && v <= l)) }'; then
+        echo -e "${GREEN}$name: $value (порог $kind $limit)${NC}"
+    else
+        echo -e "${RED}$name: $value (порог $kind $limit) — регрессия${NC}"
+        FAILED=1
+    fi
+}
+
+# разбор статистики -stats из файла вывода и проверка порогов
+check_stats() {
+    local file=$1 min_duels=$2 max_round=$3
+    check "боев/с" "$(sed -n 's/^Статистика: .*, \([0-9.]*\) боев\/с.*/\1/p' "$file")" min "$min_duels"
+    check "самый долгий раунд, мс" \
+        "$(sed -n 's/.*самый долгий раунд \([0-9.]*\) мс.*/\1/p' "$file")" max "$max_round"
+    check "брошено раундов по max_waits" \
+        "$(sed -n 's/.*брошено по max_waits \([0-9]*\).*/\1/p' "$file")" max "$MAX_STALLED_ROUNDS"
+    # p99 по всем захватам почти всегда 0: ожидания редки, поэтому порог на ждавших и max
+    check "p99 ожидания ждавших захватов, мкс" \
+        "$(sed -n 's/^Ожидание блокировки.* p99 ждавших \([0-9.]*\) мкс.*/\1/p' "$file" | sort -g | tail -1)" \
+        max "$MAX_LOCK_WAIT_P99_US"
+    check "самое долгое ожидание блокировки, мкс" \
+        "$(sed -n 's/^Ожидание блокировки.* max \([0-9.]*\) мкс.*/\1/p' "$file" | sort -g | tail -1)" \
+        max "$MAX_LOCK_WAIT_US"
+    grep "^Ожидание блокировки\|^Зависания" "$file"
+}
+
+echo -e "${BLUE}1. Сборка (обычная и с ThreadSanitizer)...${NC}"
+for dir in version_4_8/build_stress version_9_10/build_stress; do
+    build "$dir" || { echo -e "${RED}Ошибка сборки $dir${NC}"; exit 1; }
+done
+for dir in version_4_8/build_tsan version_9_10/build_tsan; do
+    build "$dir" -DTOURNAMENT_TSAN=ON || { echo -e "${RED}Ошибка сборки $dir${NC}"; exit 1; }
+done
+echo -e "${GREEN}Успешно${NC}"
+
+echo ""
+echo -e "${BLUE}2. Переподписка: ядер $STRESS_CPUS${CGROUP_DIR:+, квота cpu.max $STRESS_CPU_MAX}${NC}"
+
+echo ""
+echo "version_4_8: 32 потока-бойца"
+run_limited version_4_8/build_stress/tournament 32 -seed 38 -stats -o version_4_8/build_stress/stress_4_8.txt > /dev/null
+check_stats version_4_8/build_stress/stress_4_8.txt "$MIN_DUELS_THREADS" "$MAX_ROUND_MS_THREADS"
+
+echo ""
+echo "version_9_10: 32 потока-бойца"
+run_limited version_9_10/build_stress/tournament 32 -engine threads -seed 38 -stats -quiet \
+    -o version_9_10/build_stress/stress_9_10_threads.txt
+check_stats version_9_10/build_stress/stress_9_10_threads.txt "$MIN_DUELS_THREADS" "$MAX_ROUND_MS_THREADS"
+
+echo ""
+echo "version_9_10: 1000000 бойцов, движок coro на 16 рабочих потоках"
+run_limited version_9_10/build_stress/tournament 1000000 -engine coro -workers 16 -seed 38 -stats \
+    -quiet -o version_9_10/build_stress/stress_9_10_coro.txt
+check_stats version_9_10/build_stress/stress_9_10_coro.txt "$MIN_DUELS_CORO" "$MAX_ROUND_MS_CORO"
+
+echo ""
+echo -e "${BLUE}3. ThreadSanitizer (гонки на флагах боя и rival_id)...${NC}"
+
+# прогон под TSan: ошибка при ненулевом коде или любом отчете о гонке
+run_tsan() {
+    local name=$1 log=$2
+    shift 2
+    TSAN_OPTIONS="halt_on_error=1 exitcode=66" run_limited "$@" > "$log" 2>&1
+    local code=$?
+    if [ $code -eq 0 ] && ! grep -q "WARNING: ThreadSanitizer" "$log"; then
+        echo -e "${GREEN}$name: гонок нет${NC}"
+    else
+        echo -e "${RED}$name: код $code, отчет в $log${NC}"
+        grep -A 12 "WARNING: ThreadSanitizer" "$log" | head -30
+        FAILED=1
+    fi
+}
+
+run_tsan "version_4_8, 16 потоков" version_4_8/build_tsan/tsan_4_8.txt \
+    version_4_8/build_tsan/tournament 16 -seed 38
+run_tsan "version_9_10, 16 потоков" version_9_10/build_tsan/tsan_9_10_threads.txt \
+    version_9_10/build_tsan/tournament 16 -engine threads -seed 38
+run_tsan "version_9_10, движок coro" version_9_10/build_tsan/tsan_9_10_coro.txt \
+    version_9_10/build_tsan/tournament 100000 -engine coro -workers 8 -seed 38 -quiet
+run_tsan "version_9_10, пакетный режим" version_9_10/build_tsan/tsan_9_10_batch.txt \
+    version_9_10/build_tsan/tournament -batch version_9_10/test_batch_correct.txt -quiet
+
+echo ""
+if [ $FAILED -eq 0 ]; then
+    echo -e "${GREEN}--- Нагрузочный прогон пройден ---${NC}"
+else
+    echo -e "${RED}--- Нагрузочный прогон выявил регрессии ---${NC}"
+fi
+exit $FAILED
@@ -12,6 +12,8 @@
 #include <stdarg.h>
 
 #define MAX_FIGHTERS 32  // max количество бойцов
+#define DRAIN_DEFAULT_MS 2000  // предел дренажа после сигнала по умолчанию (-drain-ms)
+#define LOCK_HIST_BUCKETS 40  // корзины гистограммы ожидания семафора (степени двойки нс)
 
 // возможные жесты в игре
 typedef enum {
@@ -31,6 +33,14 @@ typedef struct {
     pthread_t thread_id; // ID потока
 } Combatant;
 
+// статистика ожидания семафора арены (-stats); поля меняются под самим семафором
+typedef struct {
+    long acquired;  // захватов
+    long contended;  // захватов, которым пришлось ждать
+    long long max_ns;  // самое долгое ожидание
+    long hist[LOCK_HIST_BUCKETS];  // ожиданий длительностью [2^i, 2^(i+1)) нс
+} LockStats;
+
 // арена турнира
 typedef struct {
     Combatant fighters[MAX_FIGHTERS];  // массив всех бойцов
@@ -38,6 +48,7 @@ typedef struct {
     int alive_count;  // количество активных бойцов
     int round_num; // № текущего раунда
     int finished;  // флаг завершения турнира
+    int threads_ready;  // сколько потоков-бойцов запущено (под round_mutex)
     sem_t arena_sem; // семафор для защиты критических секций
     pthread_mutex_t round_mutex; // мьютекс для условной переменной
     pthread_cond_t round_cond; // условная переменная для синхронизации раундов
@@ -46,9 +57,28 @@ typedef struct {
 Arena arena; // глобальная арена
 int fighter_count; // количество бойцов
 pthread_t fighter_threads[MAX_FIGHTERS]; // ID потоков-бойцов
+int fighter_ids[MAX_FIGHTERS];  // аргументы потоков-бойцов
+struct timespec start_time;  // начало турнира после разбора параметров (CLOCK_MONOTONIC)
+double first_duel_ms = -1;  // время до первого боя (под arena_sem, -1 — боев не было)
+
+// статистика конкуренции (-stats)
+int collect_stats = 0;
+LockStats sem_stats;  // ожидание arena_sem
+int stall_waits = 0;  // дополнительных ожиданий боев после паузы раунда
+int stalled_rounds = 0;  // раундов, прерванных по max_waits с незавершенными боями
+double max_round_ms = 0;  // самый долгий раунд
 FILE* output_file = NULL; // файл для вывода результатов
 int use_file_output = 0;  // флаг вывода в файл
 
+// остановка по сигналу: SIGINT/SIGTERM заблокированы во всех потоках, их ждет отдельный поток
+sigset_t shutdown_signals;  // ожидаемые сигналы
+int stop_signal = 0;  // полученный сигнал (0 — сигнала не было)
+int drained = 0;  // дренаж завершен
+int drain_ms = DRAIN_DEFAULT_MS;  // предел дренажа
+struct timespec signal_time;  // момент получения сигнала (CLOCK_MONOTONIC)
+pthread_mutex_t shutdown_mutex = PTHREAD_MUTEX_INITIALIZER;  // защита полей остановки
+pthread_cond_t drained_cond = PTHREAD_COND_INITIALIZER;  // сигнал о завершении дренажа
+
 // функция вывода в консоль и/или файл
 void print_output(const char* format, ...) {
     va_list args1, args2;
@@ -62,12 +92,51 @@ void print_output(const char* format, ...) {
     va_end(args1);
 }
 
-// ожидание семафора с обработкой прерываний
+// ожидание семафора с обработкой прерываний (при -stats ожидание измеряется)
 void semaphore_wait(sem_t* sem) {
+    if (collect_stats && sem_trywait(sem) == 0) {
+        sem_stats.acquired++;
+        return;
+    }
+    struct timespec start;
+    if (collect_stats) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
     int result;
     do {
         result = sem_wait(sem);
     } while (result == EINTR);  // повторяем если было прерывание
+    if (collect_stats) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long ns = (now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec);
+        int bucket = ns > 0 ? 63 - __builtin_clzll(ns) : 0;
+        sem_stats.acquired++;
+        sem_stats.contended++;
+        sem_stats.hist[bucket < LOCK_HIST_BUCKETS ? bucket : LOCK_HIST_BUCKETS - 1]++;
+        if (ns > sem_stats.max_ns) {
+            sem_stats.max_ns = ns;
+        }
+    }
+}
+
+// квантиль ожидания семафора по всем захватам или только по ждавшим (contended_only), нс
+// (верхняя граница корзины гистограммы)
+long long lock_stats_quantile(LockStats* stats, double q, int contended_only) {
+    long acquired = contended_only ? stats->contended : stats->acquired;
+    long target = (long)(q * acquired + 0.999999);
+    long seen = acquired - stats->contended;  // захваты без ожидания
+    if (seen >= target) {
+        return 0;
+    }
+    for (int i = 0; i < LOCK_HIST_BUCKETS; i++) {
+        seen += stats->hist[i];
+        if (seen >= target) {
+            long long bound = 1LL << (i + 1);
+            return bound < stats->max_ns ? bound : stats->max_ns;  // корзина не выше самого долгого ожидания
+        }
+    }
+    return stats->max_ns;
 }
 
 // освобождение семафора
@@ -75,6 +144,101 @@ void semaphore_post(sem_t* sem) {
     sem_post(sem);
 }
 
+// запрошена ли остановка по сигналу
+int stop_requested() {
+    pthread_mutex_lock(&shutdown_mutex);
+    int result = stop_signal != 0;
+    pthread_mutex_unlock(&shutdown_mutex);
+    return result;
+}
+
+// пауза на ms миллисекунд, прерываемая запросом остановки
+void pause_unless_stopped(int ms) {
+    for (int waited = 0; waited < ms && !stop_requested(); waited += 10) {
+        usleep(10000);
+    }
+}
+
+// поток сигналов: запрос остановки и ожидание дренажа не дольше drain_ms
+void* shutdown_thread(void* arg) {
+    (void)arg;
+    int sig;
+    if (sigwait(&shutdown_signals, &sig) != 0) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&shutdown_mutex);
+    clock_gettime(CLOCK_MONOTONIC, &signal_time);
+    stop_signal = sig;
+    printf("\nПолучен сигнал %d: новые раунды не начинаются, дренаж до %d мс\n", sig, drain_ms);
+    fflush(stdout);
+    
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += drain_ms / 1000;
+    deadline.tv_nsec += (drain_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    int result = 0;
+    while (!drained && result != ETIMEDOUT) {
+        result = pthread_cond_timedwait(&drained_cond, &shutdown_mutex, &deadline);
+    }
+    if (drained) {
+        pthread_mutex_unlock(&shutdown_mutex);
+        return NULL;
+    }
+    
+    // дренаж не уложился в предел: сброс буферов вывода и выход
+    printf("Дренаж не завершился за %d мс, аварийный выход\n", drain_ms);
+    fflush(stdout);
+    if (output_file) {
+        fflush(output_file);
+    }
+    _exit(1);
+}
+
+// запуск потока сигналов; вызывается до создания потоков-бойцов (они наследуют маску)
+int shutdown_start() {
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    sigaddset(&shutdown_signals, SIGTERM);
+    
+    pthread_t thread;
+    if (pthread_sigmask(SIG_BLOCK, &shutdown_signals, NULL) != 0 ||
+        pthread_create(&thread, NULL, shutdown_thread, NULL) != 0) {
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+// завершение дренажа: отчет о времени остановки, если был сигнал
+void shutdown_finish() {
+    pthread_mutex_lock(&shutdown_mutex);
+    drained = 1;
+    pthread_cond_signal(&drained_cond);
+    int sig = stop_signal;
+    pthread_mutex_unlock(&shutdown_mutex);
+    
+    if (sig) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double ms = (now.tv_sec - signal_time.tv_sec) * 1e3 +
+                    (now.tv_nsec - signal_time.tv_nsec) / 1e6;
+        printf("Остановка по сигналу %d: дренаж занял %.1f мс (предел %d мс)\n", sig, ms, drain_ms);
+    }
+}
+
+// миллисекунды от начала турнира
+double elapsed_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start_time.tv_sec) * 1e3 +
+           (now.tv_nsec - start_time.tv_nsec) / 1e6;
+}
+
 // определение победителя в раунде
 HandSign get_winner(HandSign sign1, HandSign sign2) {
     if (sign1 == sign2) {
@@ -147,12 +311,15 @@ void setup_round() {
 // функция потока-бойца
 void* fighter_thread(void* arg) {
     int fighter_id = *(int*)arg;
-    free(arg);
     
     // уникальный seed для генератора случайных чисел каждого потока
     unsigned int seed = time(NULL) + fighter_id + pthread_self();
-    print_output("Боец %d (Поток %lu) начал участие в турнире.\n",
-           fighter_id, (unsigned long)pthread_self());
+    
+    // отметка о готовности вместо отдельной строки от каждого потока
+    pthread_mutex_lock(&arena.round_mutex);
+    arena.threads_ready++;
+    pthread_cond_broadcast(&arena.round_cond);
+    pthread_mutex_unlock(&arena.round_mutex);
     
     while (1) {
         semaphore_wait(&arena.arena_sem);
@@ -204,8 +371,13 @@ void* fighter_thread(void* arg) {
                 }
                 
                 duel_rounds++;
+                if (first_duel_ms < 0) {
+                    first_duel_ms = elapsed_ms();
+                }
                 my_move = rand_r(&seed) % 3; // генерация жеста текущего бойца
                 rival_move = rand_r(&seed) % 3; // генерация жеста соперника
+                arena.fighters[fighter_id].gesture = my_move;  // жесты обмена видны арене
+                arena.fighters[rival_id].gesture = rival_move;
                 winner_move = get_winner(my_move, rival_move);
                 print_output("Бой %d vs %d (раунд %d): %s vs %s => ",
                     fighter_id, rival_id, duel_rounds,
@@ -234,7 +406,9 @@ void* fighter_thread(void* arg) {
                 } else {  // Ничья
                     print_output("Ничья\n");
                     semaphore_post(&arena.arena_sem);
-                    usleep(300000);  // пауза перед следующим раундом
+                    if (!stop_requested()) {
+                        usleep(300000);  // пауза перед следующим раундом
+                    }
                     semaphore_wait(&arena.arena_sem);  // захват семафора для следующей итерации
                 }
             } while (winner_move == (HandSign)-1);  // повторять пока ничья
@@ -256,6 +430,8 @@ void* fighter_thread(void* arg) {
                     break;
                 }
                 semaphore_post(&arena.arena_sem);
+            } else {
+                continue;  // раунд начался: пары проверяются без паузы
             }
         }
         usleep(10000);  // пауза чтобы не было busy wait
@@ -265,6 +441,19 @@ void* fighter_thread(void* arg) {
     return NULL;
 }
 
+// отчет -stats: пропускная способность, зависания раундов, ожидание семафора (под arena_sem)
+void print_stats(double run_ms) {
+    int duels = arena.total_count - arena.alive_count;
+    print_output("Статистика: боев %d за %.3f с, %.1f боев/с, самый долгий раунд %.1f мс\n",
+                 duels, run_ms / 1e3, run_ms > 0 ? duels * 1e3 / run_ms : 0.0, max_round_ms);
+    print_output("Зависания раундов: дополнительных ожиданий %d, брошено по max_waits %d\n",
+                 stall_waits, stalled_rounds);
+    print_output("Ожидание блокировки семафора арены: захватов %ld, с ожиданием %ld, "
+                 "p99 %.1f мкс, p99 ждавших %.1f мкс, max %.1f мкс\n",
+                 sem_stats.acquired, sem_stats.contended, lock_stats_quantile(&sem_stats, 0.99, 0) / 1e3,
+                 lock_stats_quantile(&sem_stats, 0.99, 1) / 1e3, sem_stats.max_ns / 1e3);
+}
+
 // вывод списка активных бойцов
 void print_active_fighters() {
     semaphore_wait(&arena.arena_sem);
@@ -313,13 +502,6 @@ void cleanup() {
     }
 }
 
-// обработчик сигналов прерывания
-void signal_handler(int sig) {
-    print_output("\nТурнир остановлен по сигналу %d.\n", sig);
-    cleanup();
-    exit(0);
-}
-
 // главная функция
 int main(int argc, char *argv[]) {
     char* config_file = NULL;  // имя файла конфигурации
@@ -362,6 +544,15 @@ int main(int argc, char *argv[]) {
                 output_filename = argv[i + 1];  // имя файла для вывода
                 use_file_output = 1;
                 i++;
+            } else if (strcmp(argv[i], "-drain-ms") == 0 && i + 1 < argc) {
+                drain_ms = atoi(argv[i + 1]);  // предел дренажа после сигнала
+                if (drain_ms < 1) {
+                    printf("Предел дренажа должен быть не меньше 1 мс\n");
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "-stats") == 0) {
+                collect_stats = 1;  // статистика конкуренции в конце турнира
             } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
                 custom_seed = atoi(argv[i + 1]);  // пользоватедьский seed
                 use_custom_seed = 1;
@@ -415,9 +606,13 @@ int main(int argc, char *argv[]) {
         printf("Вывод будет сохранен в файл: %s\n", output_filename);
     }
     
-    // установка обработчиков сигналов
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // поток сигналов запускается до потоков-бойцов; отсюда отсчитывается время до первого боя
+    // (ввод параметров, в том числе интерактивный, в него не входит)
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    if (shutdown_start() != 0) {
+        perror("Ошибка запуска потока сигналов");
+        return 1;
+    }
     
     // инициализация генератора случайных чисел
     if (use_custom_seed) {
@@ -451,18 +646,23 @@ int main(int argc, char *argv[]) {
     // создание потоков-бойцов
     print_output("Создание потоков-бойцов...\n");
     for (int i = 0; i < fighter_count; i++) {
-        int* fighter_id = malloc(sizeof(int));
-        *fighter_id = i;
-        if (pthread_create(&fighter_threads[i], NULL, fighter_thread, fighter_id) != 0) {
+        fighter_ids[i] = i;
+        if (pthread_create(&fighter_threads[i], NULL, fighter_thread, &fighter_ids[i]) != 0) {
             perror("Ошибка создания потока");
-            free(fighter_id);
             cleanup();
             return 1;
         }
     }
     
-    sleep(2);  // пауза для инициализации всех потоков
+    // ожидание запуска всех потоков (вместо фиксированной паузы)
+    pthread_mutex_lock(&arena.round_mutex);
+    while (arena.threads_ready < fighter_count) {
+        pthread_cond_wait(&arena.round_cond, &arena.round_mutex);
+    }
+    pthread_mutex_unlock(&arena.round_mutex);
+    print_output("Потоков-бойцов готово: %d\n", fighter_count);
     print_output("\n------ Турнир начинается! ------\n");
+    double run_start = elapsed_ms();
     
     // главный цикл турнира
     int round = 0;
@@ -478,13 +678,21 @@ int main(int argc, char *argv[]) {
             break;
         }
         
+        // после сигнала новый раунд не начинается: бои прошлого раунда уже завершены
+        if (stop_requested()) {
+            print_output("\nТурнир остановлен по сигналу после раунда %d, бойцов осталось: %d\n",
+                         round, active);
+            break;
+        }
+        
         print_output("\n--- Раунд %d ---\n", ++round);
         print_output("Активных бойцов: %d\n", active);
         
+        double round_start = elapsed_ms();
         setup_round();  // организация раунда
-        sleep(3);  // пауза для проведения боев
+        pause_unless_stopped(3000);  // пауза для проведения боев
         
-        // ожидание завершения всех боев текущего раунда
+        // ожидание завершения всех боев текущего раунда (после сигнала — частый опрос до дренажа)
         int duels_active;
         int max_waits = 30;
         do {
@@ -497,19 +705,28 @@ int main(int argc, char *argv[]) {
                 }
             }
             semaphore_post(&arena.arena_sem);
-            if (duels_active) {
-                sleep(1);
+            if (duels_active && stop_requested()) {
+                usleep(10000);
+            } else if (duels_active) {
+                pause_unless_stopped(1000);
                 max_waits--;
+                stall_waits++;
             }
         } while (duels_active && max_waits > 0);
+        if (duels_active) {
+            stalled_rounds++;  // раунд брошен с незавершенными боями
+        }
+        if (elapsed_ms() - round_start > max_round_ms) {
+            max_round_ms = elapsed_ms() - round_start;
+        }
         
         print_active_fighters();  // вывод промежуточных результатов
     }
     
-    // определение победителя
+    // определение победителя (прерванный турнир победителя не имеет)
     semaphore_wait(&arena.arena_sem);
     int winner_found = 0;
-    for (int i = 0; i < fighter_count; i++) {
+    for (int i = 0; i < fighter_count && arena.alive_count == 1; i++) {
         if (arena.fighters[i].active) {
             print_output("\nТурнир завершен! Победитель: Боец %d\n", i);
             winner_found = 1;
@@ -519,10 +736,17 @@ int main(int argc, char *argv[]) {
     if (!winner_found) {
         print_output("\nТурнир завершен! Победитель не определен.\n");
     }
+    if (first_duel_ms >= 0) {
+        print_output("Время до первого боя: %.3f мс\n", first_duel_ms);
+    }
+    if (collect_stats) {
+        print_stats(elapsed_ms() - run_start);
+    }
     semaphore_post(&arena.arena_sem);
     
     print_output("Все бои завершены.\n");
     cleanup();  // очистка ресурсов
+    shutdown_finish();
     
     return 0;
 }
@@ -7,11 +7,40 @@
 #include <errno.h>
 #include <time.h>
 #include <pthread.h>
+#include <sched.h>
 #include <fcntl.h>
 #include <stdatomic.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 
-#define MAX_FIGHTERS 32
+#define MAX_FIGHTERS 32  // max бойцов для движка "поток на бойца"
+#define MAX_CORO_FIGHTERS 16777216  // max бойцов для движка coro
+#define SMALL_MAX_FIGHTERS 64  // max бойцов малой сетки (движок small выбирается автоматически)
+#define CORO_BATCH 256  // сколько бойцов рабочий поток забирает за раз
+#define TOP_MAX 10  // max размер таблицы лидеров (-top)
+#define MAX_VICTORIES 64  // верхняя граница гистограммы побед
+#define OUTPUT_LINE_MAX 1024  // размер буфера форматирования одной строки вывода
+#define OUTPUT_RESERVE (256ULL << 30)  // резерв адресов под файл вывода (256 ГБ)
+#define OUTPUT_GROW (64ULL << 20)  // шаг расширения файла вывода (64 МБ)
+#define OUTPUT_GROW_FIRST (1ULL << 20)  // первый шаг: малое отображение быстрее первой записи
+#define POOL_RESERVE (64ULL << 30)  // резерв адресов пула памяти прогона (64 ГБ)
+#define POOL_GROW (16ULL << 20)  // шаг открытия страниц пула (16 МБ)
+#define POOL_ALIGN 64  // выравнивание блоков пула (строка кэша)
+#define REPLAY_BUFFER_EVENTS 65536  // количество событий в буфере чтения replay
+#define REPLAY_MAX_REPORTS 10  // сколько нарушений выводить подробно
+#define STORE_MAGIC 0x47455354u  // "TSEG" в начале сегмента хранилища
+#define STRATEGY_MAX 8  // max строк в файле стратегий (-strategies)
+#define STRATEGY_KINDS 4  // количество видов стратегий
+#define STRATEGY_LINE_MAX 256  // max длина строки файла стратегий
+#define DRAIN_DEFAULT_MS 2000  // предел дренажа после сигнала по умолчанию (-drain-ms)
+#define BATCH_LINE_MAX 128  // max длина строки спецификации турнира в -batch
+#define BATCH_PARALLEL 8  // турниров одновременно в пакетном режиме по умолчанию
+#define SPIN_TRIES 64  // попыток захвата спинлока до уступки процессора
+#define LOCK_HIST_BUCKETS 40  // корзины гистограммы ожидания блокировок (степени двойки нс)
 
 // перечисление для жестов "Камень-ножницы-бумага"
 typedef enum {
@@ -20,19 +49,57 @@ typedef enum {
     PAPER = 2
 } HandSign;
 
+// движки проведения турнира
+typedef enum {
+    ENGINE_THREADS = 0,  // отдельный поток на каждого бойца
+    ENGINE_CORO = 1,  // бои порциями на общем пуле рабочих потоков, у бойцов нет своих потоков
+    ENGINE_SMALL = 2  // малая сетка целиком на вызывающем потоке
+} EngineType;
+
+// виды стратегий бойцов
+typedef enum {
+    STRAT_UNIFORM = 0,  // равновероятные жесты
+    STRAT_BIASED = 1,  // жесты с заданными весами
+    STRAT_COUNTER = 2,  // ответ на самый частый жест прошлых соперников
+    STRAT_MARKOV = 3  // веса следующего жеста зависят от своего прошлого жеста
+} StrategyKind;
+
+// стратегия из таблицы: вид, доля бойцов и веса жестов
+typedef struct {
+    StrategyKind kind;
+    int share;  // доля бойцов с этой стратегией
+    unsigned int weights[9];  // biased: weights[0..2]; markov: строка = прошлый жест
+    unsigned int row_total[3];  // суммы строк весов
+} StrategySpec;
+
+// таблица стратегий турнира (по умолчанию одна равновероятная)
+typedef struct {
+    StrategySpec specs[STRATEGY_MAX];
+    int count;
+    int share_total;  // сумма долей
+} StrategyTable;
+
 // структура бойца с атомарными переменными
 typedef struct {
     int id;
-    atomic_int active;  // атомарный флаг активности бойца
     atomic_int victories;  // атомарный счетчик побед
-    atomic_int has_rival;  // атомарный флаг наличия соперника
     atomic_int rival_id; // атомарный ID соперника
-    pthread_t thread_id; // идентификатор потока
+    unsigned int seed;  // состояние генератора жестов бойца
+    int duel_rounds;  // номер обмена жестами в текущем бою
+    uint8_t materialized;  // seed и стратегия назначены (0 — память пула обнулена)
+    uint8_t strategy;  // индекс стратегии в таблице турнира
+    uint8_t last_move;  // свой прошлый жест (для markov)
+    uint16_t seen[3];  // сколько раз соперники показали каждый жест (для counter)
 } Combatant;
 
 // арена турнира
 typedef struct {
-    Combatant fighters[MAX_FIGHTERS];  // массив бойцов
+    Combatant* fighters;  // массив бойцов
+    int* ready_fighters;  // бойцы, назначенные в бой в текущем раунде
+    int ready_count;  // количество назначенных в бой (всегда четное)
+    _Atomic uint64_t* alive_bits;  // битовое множество живых бойцов
+    _Atomic uint64_t* duel_bits;  // битовое множество бойцов, назначенных в бой
+    int bit_words;  // количество 64-битных слов в каждом множестве
     int total_count; // общее количество бойцов
     atomic_int alive_count;  // атомарный счетчик живых бойцов
     atomic_int round_num;  // атомарный номер текущего раунда
@@ -41,23 +108,877 @@ typedef struct {
     atomic_int round_started; // атомарный флаг начала раунда
 } Arena;
 
-Arena arena;
-int fighter_count;
-pthread_t fighter_threads[MAX_FIGHTERS];
-FILE* output_file = NULL;
-int use_file_output = 0;
+// типы событий в записи турнира
+typedef enum {
+    EV_START = 1,  // a = количество бойцов, b = seed_base, c = флаг фиксированного seed
+    EV_ROUND = 2,  // a = номер раунда, b = количество живых бойцов
+    EV_PAIR = 3,  // a, b = бойцы организованного боя
+    EV_DUEL = 4,  // a = ведущий боец, b = соперник, c = победитель или -1
+    EV_FINISH = 5  // a = победитель турнира или -1
+} EventType;
+
+// запись события фиксированного размера (16 байт)
+typedef struct {
+    uint8_t type;  // тип события (EventType)
+    uint8_t move1;  // жест ведущего бойца (для EV_DUEL)
+    uint8_t move2;  // жест соперника (для EV_DUEL)
+    uint8_t reserved;
+    int32_t a;
+    int32_t b;
+    int32_t c;
+} EventRecord;
+
+// журнал боев прогона для хранилища результатов (колонки, по одной записи на бой)
+typedef struct {
+    int32_t* fighter_a;  // ведущий боец
+    int32_t* fighter_b;  // соперник
+    int32_t* winner;  // победитель
+    uint16_t* draws;  // ничьих до решающего обмена
+    atomic_int count;  // записанных боев
+} DuelLog;
+
+// заголовок сегмента в duels.col; за ним колонки боев и колонки по бойцам
+typedef struct {
+    uint32_t magic;  // STORE_MAGIC
+    uint32_t fighters;  // количество бойцов прогона
+    uint32_t duels;  // количество боев прогона
+    uint32_t reserved;
+    int64_t run_id;  // номер прогона
+} SegmentHeader;
+
+// запись индекса прогонов runs.idx (номер прогона = номер записи)
+typedef struct {
+    int64_t run_id;
+    int64_t segment_offset;  // смещение сегмента в duels.col
+    int64_t timestamp;  // время завершения прогона
+    int32_t fighters;
+    int32_t duels;
+    int32_t seed;  // seed_base прогона: -seed с этим значением повторяет прогон
+    int32_t winner;  // победитель турнира или -1
+} RunRecord;
+
+// накопленные итоги бойца в fighters.agg: боец i — запись i + 1; запись 0 — заголовок,
+// его runs = сколько прогонов индекса учтено (итоги — кэш, восстанавливаемый по сегментам)
+typedef struct {
+    uint32_t runs;  // турниров с участием
+    uint32_t wins;
+    uint32_t losses;
+    uint32_t draws;
+    uint32_t titles;  // побед в турнирах
+} FighterAggregate;
+
+// файл вывода, отображенный в память
+typedef struct {
+    int fd;  // дескриптор файла
+    char* base;  // начало зарезервированной области адресов
+    atomic_size_t mapped;  // сколько байт файла уже отображено
+    atomic_size_t offset;  // сколько байт занято строками
+    atomic_size_t valid_end;  // конец целых строк до первой ошибки записи (SIZE_MAX — ошибок нет)
+    int error;  // errno первой ошибки записи (под grow_mutex)
+    pthread_mutex_t grow_mutex;  // мьютекс расширения отображения
+} OutputSink;
+
+// пул памяти прогона: блоки выделяются сдвигом used, освобождаются все сразу сбросом
+typedef struct {
+    char* base;  // начало зарезервированной области адресов
+    size_t committed;  // сколько байт открыто для записи
+    size_t used;  // сколько байт занято блоками текущего прогона
+    size_t peak;  // max used за все прогоны (выше память еще ни разу не выдавалась)
+} MemoryPool;
+
+// статистика ожидания блокировки (-stats)
+typedef struct {
+    atomic_long acquired;  // захватов
+    atomic_long contended;  // захватов, которым пришлось ждать
+    atomic_llong wait_ns;  // суммарное ожидание
+    atomic_llong max_ns;  // самое долгое ожидание
+    atomic_long hist[LOCK_HIST_BUCKETS];  // ожиданий длительностью [2^i, 2^(i+1)) нс
+} LockStats;
+
+// блокировки турнира, для которых ведется статистика
+typedef enum {
+    LOCK_ARENA = 0,  // спинлок арены (setup_round)
+    LOCK_STANDINGS = 1,  // спинлок таблицы лидеров
+    LOCK_KINDS = 2
+} LockKind;
+
+// турнирное дерево (winner tree) для таблицы лидеров
+typedef struct {
+    uint64_t* tree;  // tree[1] — корень, листья с индекса leaves; узел хранит ключ лучшего бойца
+    int leaves;  // количество листьев (степень двойки >= количества бойцов)
+    int count;  // количество бойцов
+    int victory_hist[MAX_VICTORIES + 1];  // количество бойцов с данным числом побед
+    pthread_spinlock_t lock;  // защита дерева при одновременных победах
+} Standings;
+
+// контекст турнира: все состояние одного прогона, движок не использует глобальных переменных
+typedef struct Tournament {
+    Arena arena;
+    Standings standings;
+    int fighter_count;
+    EngineType engine;
+    pthread_t* fighter_threads;  // потоки-бойцы (движок threads)
+    int custom_seed;
+    int use_custom_seed;
+    unsigned int seed_base;  // база для seed бойцов
+    unsigned int pairing_seed;  // состояние генератора перемешивания пар (вместо rand())
+    int top_count;  // размер таблицы лидеров после каждого раунда
+    OutputSink output_sink;
+    int use_file_output;
+    int console_echo;  // дублировать вывод в консоль (-quiet отключает)
+    FILE* record_file;  // файл записи событий (-rec)
+    const char* store_dir;  // каталог хранилища результатов (-store)
+    StrategyTable strategies;  // стратегии бойцов (-strategies)
+    MemoryPool* pool;  // пул памяти прогона (все массивы турнира)
+    atomic_long round_allocations;  // выделений в куче во время раундов
+    DuelLog duel_log;
+    
+    // буфер вывода турнира (пакетный режим собирает вывод и печатает по порядку строк)
+    int buffer_output;
+    MemoryPool* output_pool;  // отдельный пул буфера, растет на месте
+    char* buffer;
+    size_t buffer_len;
+    size_t buffer_cap;
+    pthread_mutex_t buffer_mutex;
+    
+    // раздача боев раунда в общий пул (поля очереди защищены мьютексом пула)
+    struct Tournament* next_queued;  // следующий турнир в очереди пула
+    int next_task;  // индекс следующей порции бойцов
+    int published;  // сколько бойцов раунда уже разбито на пары и доступно пулу
+    int batches_left;  // порций раунда, еще не обработанных пулом
+    pthread_mutex_t round_mutex;
+    pthread_cond_t round_cond;  // сигнал о завершении раунда
+    
+    // метрики запуска
+    struct timespec start_time;  // начало турнира (CLOCK_MONOTONIC)
+    long long setup_ns;  // длительность подготовки
+    atomic_llong first_duel_ns;  // время до первого обмена жестами (0 — боев еще не было)
+    int threads_ready;  // потоков-бойцов, прошедших стартовый барьер (под round_mutex)
+    
+    // статистика конкуренции (-stats)
+    int collect_stats;
+    LockStats lock_stats[LOCK_KINDS];  // ожидание блокировок по видам (LockKind)
+    int stall_waits;  // дополнительных ожиданий боев после паузы раунда
+    int stalled_rounds;  // раундов, прерванных по max_waits с незавершенными боями
+    long long max_round_ns;  // самый долгий раунд
+} Tournament;
+
+// аргумент потока-бойца
+typedef struct {
+    Tournament* t;
+    int fighter_id;
+} FighterArg;
+
+// общий пул рабочих потоков движка coro: раздает порции боев всех турниров процесса
+typedef struct {
+    pthread_t* threads;  // рабочие потоки
+    int count;  // количество рабочих потоков
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;  // сигнал о новых порциях в очереди
+    int shutdown;  // флаг остановки пула
+    Tournament* head;  // очередь турниров с нераспределенными порциями
+    Tournament* tail;
+    int ready;  // рабочих потоков, прошедших стартовый барьер
+    pthread_cond_t ready_cond;  // сигнал стартового барьера
+    int collect_stats;  // вести статистику ожидания мьютекса (-stats)
+    LockStats lock_stats;
+} CoroPool;
+
+// остановка по сигналу: SIGINT/SIGTERM заблокированы во всех потоках, их ждет отдельный поток
+typedef struct {
+    sigset_t signals;  // ожидаемые сигналы
+    atomic_int signal_number;  // полученный сигнал (0 — сигнала не было)
+    struct timespec received;  // момент получения сигнала (CLOCK_MONOTONIC)
+    int drain_ms;  // предел дренажа
+    OutputSink* sink;  // файл вывода, обрезаемый при аварийном выходе
+    FILE* record;  // файл записи событий (-rec), сбрасываемый при аварийном выходе
+    int drained;  // дренаж завершен
+    pthread_mutex_t mutex;
+    pthread_cond_t drained_cond;
+} ShutdownControl;
+
+CoroPool coro_pool;
+ShutdownControl shutdown_control = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+atomic_uint seed_counter;  // номер турнира в процессе для seed без -seed
+_Thread_local Tournament* round_owner;  // турнир, раунды которого ведет текущий поток
+
+// счетчик выделений в куче: обертки над malloc glibc учитывают вызовы из раундов
+// (под санитайзерами malloc перехватывает их runtime, счетчик отключен)
+#if defined(__SANITIZE_THREAD__) || defined(__SANITIZE_ADDRESS__)
+#define ALLOC_COUNTER 0
+#else
+#define ALLOC_COUNTER 1
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+// учет выделения для турнира текущего потока
+void count_allocation(void) {
+    if (round_owner) {
+        atomic_fetch_add_explicit(&round_owner->round_allocations, 1, memory_order_relaxed);
+    }
+}
+
+void* malloc(size_t size) {
+    count_allocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    count_allocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    count_allocation();
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+// монотонное время в наносекундах
+long long monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// учет одного захвата блокировки с ожиданием wait_ns (0 — захвачена сразу)
+void lock_stats_record(LockStats* stats, long long wait_ns) {
+    atomic_fetch_add_explicit(&stats->acquired, 1, memory_order_relaxed);
+    if (wait_ns <= 0) {
+        return;
+    }
+    atomic_fetch_add_explicit(&stats->contended, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->wait_ns, wait_ns, memory_order_relaxed);
+    long long max = atomic_load_explicit(&stats->max_ns, memory_order_relaxed);
+    while (wait_ns > max &&
+           !atomic_compare_exchange_weak(&stats->max_ns, &max, wait_ns)) {
+    }
+    int bucket = 63 - __builtin_clzll(wait_ns);
+    atomic_fetch_add_explicit(&stats->hist[bucket < LOCK_HIST_BUCKETS ? bucket : LOCK_HIST_BUCKETS - 1],
+                              1, memory_order_relaxed);
+}
+
+// квантиль ожидания по всем захватам или только по ждавшим (contended_only), нс
+// (верхняя граница корзины гистограммы)
+long long lock_stats_quantile(LockStats* stats, double q, int contended_only) {
+    long contended = atomic_load(&stats->contended);
+    long acquired = contended_only ? contended : atomic_load(&stats->acquired);
+    long target = (long)(q * acquired + 0.999999);
+    long seen = acquired - contended;  // захваты без ожидания
+    if (seen >= target) {
+        return 0;
+    }
+    for (int i = 0; i < LOCK_HIST_BUCKETS; i++) {
+        seen += atomic_load(&stats->hist[i]);
+        if (seen >= target) {
+            long long bound = 1LL << (i + 1);
+            return bound < atomic_load(&stats->max_ns) ? bound : atomic_load(&stats->max_ns);  // корзина не выше самого долгого ожидания
+        }
+    }
+    return atomic_load(&stats->max_ns);
+}
+
+// захват спинлока: после SPIN_TRIES неудачных попыток поток уступает процессор, иначе при
+// потоках больше ядер ожидающий крутится весь квант, пока вытесненный держатель стоит;
+// при stats != NULL ожидание измеряется
+void stats_spin_lock(pthread_spinlock_t* lock, LockStats* stats) {
+    if (pthread_spin_trylock(lock) == 0) {
+        if (stats) {
+            lock_stats_record(stats, 0);
+        }
+        return;
+    }
+    long long start = stats ? monotonic_ns() : 0;
+    for (int tries = 1; pthread_spin_trylock(lock) != 0; tries++) {
+        if (tries % SPIN_TRIES == 0) {
+            sched_yield();
+        }
+    }
+    if (stats) {
+        lock_stats_record(stats, monotonic_ns() - start);
+    }
+}
+
+// захват мьютекса общего пула с учетом ожидания при -stats
+void coro_lock(void) {
+    if (!coro_pool.collect_stats) {
+        pthread_mutex_lock(&coro_pool.mutex);
+        return;
+    }
+    if (pthread_mutex_trylock(&coro_pool.mutex) == 0) {
+        lock_stats_record(&coro_pool.lock_stats, 0);
+        return;
+    }
+    long long start = monotonic_ns();
+    pthread_mutex_lock(&coro_pool.mutex);
+    lock_stats_record(&coro_pool.lock_stats, monotonic_ns() - start);
+}
+
+// статистика блокировки турнира или NULL без -stats
+LockStats* tournament_lock_stats(Tournament* t, LockKind kind) {
+    return t->collect_stats ? &t->lock_stats[kind] : NULL;
+}
+
+// слот упорядочивания вывода пакетного режима
+typedef struct {
+    char* data;  // вывод турнира
+    size_t len;
+    int ready;  // турнир завершен, вывод ждет своей очереди
+} BatchSlot;
+
+// пакетный режим: файл спецификаций, ограниченное окно турниров, вывод по порядку
+typedef struct {
+    const char* data;  // отображенный в память файл спецификаций
+    size_t size;
+    size_t pos;  // позиция разбора
+    int line;  // номер текущей строки файла
+    long long next_index;  // номер следующего выдаваемого турнира
+    long long next_write;  // номер турнира, чей вывод печатается следующим
+    int window;  // max турниров между разбором и печатью
+    BatchSlot* slots;  // кольцо из window слотов
+    pthread_mutex_t mutex;
+    pthread_cond_t slot_cond;  // сигнал об освобождении места в окне
+    Tournament* options;  // общие настройки (-top, -o, -quiet)
+    long long failed;  // строк с ошибками
+} BatchState;
+
+// запрошена ли остановка по сигналу
+int stop_requested(void) {
+    return atomic_load(&shutdown_control.signal_number) != 0;
+}
+
+// размер файла вывода: занятые строки, но не дальше первой ошибки записи
+size_t sink_size(OutputSink* sink) {
+    size_t size = atomic_load(&sink->offset);
+    size_t valid_end = atomic_load(&sink->valid_end);
+    return size < valid_end ? size : valid_end;
+}
+
+// файл вывода больше не обрезается при аварийном выходе (закрывается штатно)
+void shutdown_forget_sink(OutputSink* sink) {
+    pthread_mutex_lock(&shutdown_control.mutex);
+    if (shutdown_control.sink == sink) {
+        shutdown_control.sink = NULL;
+    }
+    pthread_mutex_unlock(&shutdown_control.mutex);
+}
+
+// файл записи событий закрывается штатно и при аварийном выходе больше не сбрасывается
+void shutdown_forget_record(FILE* record) {
+    pthread_mutex_lock(&shutdown_control.mutex);
+    if (shutdown_control.record == record) {
+        shutdown_control.record = NULL;
+    }
+    pthread_mutex_unlock(&shutdown_control.mutex);
+}
+
+// поток сигналов: запрос остановки и ожидание дренажа не дольше drain_ms
+void* shutdown_thread(void* arg) {
+    ShutdownControl* control = arg;
+    int sig;
+    if (sigwait(&control->signals, &sig) != 0) {
+        return NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &control->received);
+    atomic_store(&control->signal_number, sig);
+    printf("\nПолучен сигнал %d: новые раунды не начинаются, дренаж до %d мс\n",
+           sig, control->drain_ms);
+    fflush(stdout);
+    
+    struct timespec deadline = control->received;
+    deadline.tv_sec += control->drain_ms / 1000;
+    deadline.tv_nsec += (control->drain_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    
+    pthread_mutex_lock(&control->mutex);
+    int result = 0;
+    while (!control->drained && result != ETIMEDOUT) {
+        result = pthread_cond_timedwait(&control->drained_cond, &control->mutex, &deadline);
+    }
+    if (control->drained) {
+        pthread_mutex_unlock(&control->mutex);
+        return NULL;
+    }
+    
+    // дренаж не уложился в предел: файл вывода обрезается по записанным строкам, выход
+    if (control->sink && control->sink->fd >= 0 &&
+        ftruncate(control->sink->fd, sink_size(control->sink)) != 0) {
+        perror("Ошибка обрезки файла вывода");
+    }
+    // запись событий сбрасывается под блокировкой потока FILE, которая не снимается до выхода:
+    // fwrite события атомарен, поэтому в файле остаются только целые записи
+    if (control->record) {
+        flockfile(control->record);
+        if (fflush(control->record) != 0) {
+            perror("Ошибка записи файла событий");
+        }
+    }
+    printf("Дренаж не завершился за %d мс, аварийный выход\n", control->drain_ms);
+    fflush(stdout);
+    _exit(1);
+}
+
+// запуск потока сигналов; вызывается до создания остальных потоков (они наследуют маску)
+int shutdown_start(int drain_ms, OutputSink* sink, FILE* record) {
+    ShutdownControl* control = &shutdown_control;
+    sigemptyset(&control->signals);
+    sigaddset(&control->signals, SIGINT);
+    sigaddset(&control->signals, SIGTERM);
+    control->drain_ms = drain_ms;
+    control->sink = sink->fd >= 0 ? sink : NULL;
+    control->record = record;
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&control->drained_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    
+    pthread_t thread;
+    if (pthread_sigmask(SIG_BLOCK, &control->signals, NULL) != 0 ||
+        pthread_create(&thread, NULL, shutdown_thread, control) != 0) {
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+// завершение дренажа: отчет о времени остановки, если был сигнал
+void shutdown_finish(void) {
+    ShutdownControl* control = &shutdown_control;
+    pthread_mutex_lock(&control->mutex);
+    control->drained = 1;
+    pthread_cond_signal(&control->drained_cond);
+    pthread_mutex_unlock(&control->mutex);
+    
+    int sig = atomic_load(&control->signal_number);
+    if (sig) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double ms = (now.tv_sec - control->received.tv_sec) * 1e3 +
+                    (now.tv_nsec - control->received.tv_nsec) / 1e6;
+        printf("Остановка по сигналу %d: дренаж занял %.1f мс (предел %d мс)\n",
+               sig, ms, control->drain_ms);
+    }
+}
+
+// открытие файла вывода: резерв адресов без памяти, файл растет через sink_grow
+int sink_open(OutputSink* sink, const char* filename) {
+    sink->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (sink->fd < 0) {
+        return -1;
+    }
+    void* base = mmap(NULL, OUTPUT_RESERVE, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        close(sink->fd);
+        sink->fd = -1;
+        return -1;
+    }
+    sink->base = base;
+    atomic_store(&sink->mapped, 0);
+    atomic_store(&sink->offset, 0);
+    atomic_store(&sink->valid_end, SIZE_MAX);
+    sink->error = 0;
+    pthread_mutex_init(&sink->grow_mutex, NULL);
+    return 0;
+}
+
+// расширение отображения до end байт (адреса области не меняются),
+// шаг удваивается от OUTPUT_GROW_FIRST до OUTPUT_GROW
+int sink_grow(OutputSink* sink, size_t end) {
+    int result = 0;
+    pthread_mutex_lock(&sink->grow_mutex);
+    size_t mapped = atomic_load(&sink->mapped);
+    while (mapped < end) {
+        size_t step = mapped == 0 ? OUTPUT_GROW_FIRST
+                    : mapped < OUTPUT_GROW ? mapped : OUTPUT_GROW;
+        if (ftruncate(sink->fd, mapped + step) != 0 ||
+            mmap(sink->base + mapped, step, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_FIXED, sink->fd, mapped) == MAP_FAILED) {
+            result = -1;
+            break;
+        }
+        mapped += step;
+        atomic_store(&sink->mapped, mapped);
+    }
+    pthread_mutex_unlock(&sink->grow_mutex);
+    return result;
+}
+
+// отметка ошибки записи строки с позиции pos: файл кончится перед самой ранней такой строкой
+void sink_fail(OutputSink* sink, size_t pos, int error) {
+    pthread_mutex_lock(&sink->grow_mutex);
+    if (pos < atomic_load(&sink->valid_end)) {
+        atomic_store(&sink->valid_end, pos);
+    }
+    if (!sink->error) {
+        sink->error = error;
+    }
+    pthread_mutex_unlock(&sink->grow_mutex);
+}
+
+// запись строки: место занимается атомарным сдвигом offset, копирование без блокировок;
+// после первой ошибки расширения строки не принимаются, чтобы в файле не было дыр
+void sink_write(OutputSink* sink, const char* data, size_t len) {
+    if (atomic_load(&sink->valid_end) != SIZE_MAX) {
+        return;
+    }
+    size_t pos = atomic_fetch_add(&sink->offset, len);
+    size_t end = pos + len;
+    if (end > OUTPUT_RESERVE) {
+        sink_fail(sink, pos, EFBIG);  // резерв адресов исчерпан
+        return;
+    }
+    if (end > atomic_load(&sink->mapped) && sink_grow(sink, end) != 0) {
+        sink_fail(sink, pos, errno);  // например, ENOSPC при ftruncate
+        return;
+    }
+    memcpy(sink->base + pos, data, len);
+}
+
+// закрытие файла вывода с обрезкой до фактического размера
+void sink_close(OutputSink* sink) {
+    if (sink->fd < 0) {
+        return;
+    }
+    shutdown_forget_sink(sink);
+    size_t size = sink_size(sink);
+    munmap(sink->base, OUTPUT_RESERVE);
+    if (ftruncate(sink->fd, size) != 0) {
+        perror("Ошибка обрезки файла вывода");
+    }
+    if (sink->error) {
+        printf("Ошибка записи файла вывода: %s; сохранено %zu байт, дальнейшие строки потеряны\n",
+               strerror(sink->error), size);
+    }
+    close(sink->fd);
+    pthread_mutex_destroy(&sink->grow_mutex);
+    sink->fd = -1;
+    sink->base = NULL;
+}
+
+// резервирование адресов пула (страницы открываются по мере выделения)
+int pool_init(MemoryPool* pool) {
+    memset(pool, 0, sizeof(MemoryPool));
+    void* base = mmap(NULL, POOL_RESERVE, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    pool->base = base;
+    return 0;
+}
+
+// открытие страниц пула до end байт (адреса блоков не меняются)
+int pool_commit(MemoryPool* pool, size_t end) {
+    if (end > POOL_RESERVE) {
+        return -1;
+    }
+    while (pool->committed < end) {
+        if (mprotect(pool->base + pool->committed, POOL_GROW, PROT_READ | PROT_WRITE) != 0) {
+            return -1;
+        }
+        pool->committed += POOL_GROW;
+    }
+    return 0;
+}
+
+// выделение обнуленного блока; память выше peak еще не выдавалась и уже нулевая
+void* pool_alloc(MemoryPool* pool, size_t size) {
+    size_t offset = (pool->used + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+    size_t end = offset + size;
+    if (pool_commit(pool, end) != 0) {
+        return NULL;
+    }
+    if (offset < pool->peak) {
+        memset(pool->base + offset, 0, (end < pool->peak ? end : pool->peak) - offset);
+    }
+    pool->used = end;
+    if (end > pool->peak) {
+        pool->peak = end;
+    }
+    return pool->base + offset;
+}
+
+// освобождение всех блоков прогона (страницы остаются открытыми для следующего)
+void pool_reset(MemoryPool* pool) {
+    pool->used = 0;
+}
+
+// возврат области пула системе
+void pool_destroy(MemoryPool* pool) {
+    if (pool->base) {
+        munmap(pool->base, POOL_RESERVE);
+    }
+    memset(pool, 0, sizeof(MemoryPool));
+}
+
+// добавление строки в буфер вывода турнира (буфер — начало output_pool)
+void buffer_append(Tournament* t, const char* text, size_t len) {
+    pthread_mutex_lock(&t->buffer_mutex);
+    if (t->buffer_len + len > t->buffer_cap) {
+        if (pool_commit(t->output_pool, t->buffer_len + len) != 0) {
+            pthread_mutex_unlock(&t->buffer_mutex);
+            return;
+        }
+        t->buffer = t->output_pool->base;
+        t->buffer_cap = t->output_pool->committed;
+    }
+    memcpy(t->buffer + t->buffer_len, text, len);
+    t->buffer_len += len;
+    pthread_mutex_unlock(&t->buffer_mutex);
+}
 
-// универсальная функция вывода (консоль + файл)
-void print_output(const char* format, ...) {
+// универсальная функция вывода турнира (консоль + файл)
+void print_output(Tournament* t, const char* format, ...) {
+    if (!t->console_echo && !(t->use_file_output && t->output_sink.fd >= 0) && !t->buffer_output) {
+        return;  // выводить некуда: строка не форматируется
+    }
+    char line[OUTPUT_LINE_MAX];
+    char* text = line;
     va_list args1, args2;
     va_start(args1, format);
-    vprintf(format, args1);
-    if (use_file_output && output_file) {
-        va_start(args2, format);
-        vfprintf(output_file, format, args2);
-        va_end(args2);
-    }
+    va_copy(args2, args1);
+    int len = vsnprintf(line, sizeof(line), format, args1);
     va_end(args1);
+    
+    // длинная строка форматируется повторно в куче
+    if (len >= (int)sizeof(line)) {
+        text = malloc(len + 1);
+        if (text) {
+            vsnprintf(text, len + 1, format, args2);
+        }
+    }
+    va_end(args2);
+    if (len < 0 || !text) {
+        return;
+    }
+    
+    if (t->console_echo) {
+        fwrite(text, 1, len, stdout);
+    }
+    if (t->use_file_output && t->output_sink.fd >= 0) {
+        sink_write(&t->output_sink, text, len);
+    }
+    if (t->buffer_output) {
+        buffer_append(t, text, len);
+    }
+    if (text != line) {
+        free(text);
+    }
+}
+
+// запись события турнира (один fwrite на событие => записи не перемешиваются)
+void record_event(Tournament* t, EventType type, int a, int b, int c, int move1, int move2) {
+    if (!t->record_file) {
+        return;
+    }
+    EventRecord ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = (uint8_t)type;
+    ev.move1 = (uint8_t)move1;
+    ev.move2 = (uint8_t)move2;
+    ev.a = a;
+    ev.b = b;
+    ev.c = c;
+    fwrite(&ev, sizeof(ev), 1, t->record_file);
+}
+
+// запись решенного боя в журнал прогона (место занимается атомарно)
+void log_duel(Tournament* t, int fighter_a, int fighter_b, int winner, int draws) {
+    DuelLog* log = &t->duel_log;
+    if (!log->fighter_a) {
+        return;
+    }
+    int index = atomic_fetch_add(&log->count, 1);
+    log->fighter_a[index] = fighter_a;
+    log->fighter_b[index] = fighter_b;
+    log->winner[index] = winner;
+    log->draws[index] = draws < UINT16_MAX ? draws : UINT16_MAX;
+}
+
+// жив ли боец (бит в alive_bits)
+int fighter_alive(Arena* arena, int id) {
+    return (atomic_load(&arena->alive_bits[id >> 6]) >> (id & 63)) & 1;
+}
+
+// выбывание бойца
+void fighter_eliminate(Arena* arena, int id) {
+    atomic_fetch_and(&arena->alive_bits[id >> 6], ~(1ULL << (id & 63)));
+}
+
+// назначен ли боец в бой (бит в duel_bits)
+int fighter_in_duel(Arena* arena, int id) {
+    return (atomic_load(&arena->duel_bits[id >> 6]) >> (id & 63)) & 1;
+}
+
+// установка или сброс флага боя
+void fighter_set_duel(Arena* arena, int id, int in_duel) {
+    if (in_duel) {
+        atomic_fetch_or(&arena->duel_bits[id >> 6], 1ULL << (id & 63));
+    } else {
+        atomic_fetch_and(&arena->duel_bits[id >> 6], ~(1ULL << (id & 63)));
+    }
+}
+
+// поиск живого бойца с наименьшим ID (-1, если живых нет)
+int first_alive(Arena* arena) {
+    for (int w = 0; w < arena->bit_words; w++) {
+        uint64_t bits = atomic_load(&arena->alive_bits[w]);
+        if (bits) {
+            return w * 64 + __builtin_ctzll(bits);
+        }
+    }
+    return -1;
+}
+
+// ключ узла: победы в старших битах, инвертированный ID в младших (при равенстве выше меньший ID)
+uint64_t standings_key(int id, int victories) {
+    return ((uint64_t)victories << 32) | (uint32_t)(UINT32_MAX - (uint32_t)id);
+}
+
+// ID бойца по ключу узла
+int standings_id(uint64_t key) {
+    return (int)(UINT32_MAX - (uint32_t)key);
+}
+
+// построение турнирного дерева по всем бойцам
+int standings_init(Standings* standings, MemoryPool* pool, int count) {
+    memset(standings, 0, sizeof(Standings));
+    standings->leaves = 1;
+    while (standings->leaves < count) {
+        standings->leaves <<= 1;
+    }
+    standings->tree = pool_alloc(pool, 2 * standings->leaves * sizeof(uint64_t));
+    if (!standings->tree) {
+        return -1;
+    }
+    // дерево не заполняется: нулевой узел вычисляется в standings_node()
+    standings->count = count;
+    standings->victory_hist[0] = count;
+    pthread_spin_init(&standings->lock, PTHREAD_PROCESS_PRIVATE);
+    return 0;
+}
+
+// ключ узла дерева; ноль — нетронутое поддерево: у всех 0 побед, лучший — самый левый боец
+uint64_t standings_node(const Standings* standings, int node) {
+    uint64_t key = standings->tree[node];
+    if (key != 0) {
+        return key;
+    }
+    int shift = __builtin_ctz(standings->leaves) - (31 - __builtin_clz(node));
+    int first = (node << shift) - standings->leaves;
+    return first < standings->count ? standings_key(first, 0) : 0;
+}
+
+// засчитывание победы: счетчик бойца и путь от листа к корню, O(log n)
+void standings_add_victory(Tournament* t, int id) {
+    Standings* standings = &t->standings;
+    stats_spin_lock(&standings->lock, tournament_lock_stats(t, LOCK_STANDINGS));
+    int v = atomic_fetch_add(&t->arena.fighters[id].victories, 1);
+    standings->victory_hist[v < MAX_VICTORIES ? v : MAX_VICTORIES]--;
+    standings->victory_hist[v + 1 < MAX_VICTORIES ? v + 1 : MAX_VICTORIES]++;
+    
+    int node = standings->leaves + id;
+    uint64_t key = standings_key(id, v + 1);
+    standings->tree[node] = key;
+    // подъем, пока новый ключ побеждает соседа (победы только растут)
+    for (node >>= 1; node >= 1 && standings_node(standings, node) < key; node >>= 1) {
+        standings->tree[node] = key;
+    }
+    pthread_spin_unlock(&standings->lock);
+}
+
+// место бойца по числу побед (равные делят место), O(MAX_VICTORIES)
+int standings_rank(Tournament* t, int id) {
+    int v = atomic_load(&t->arena.fighters[id].victories);
+    int rank = 1;
+    for (int i = (v < MAX_VICTORIES ? v : MAX_VICTORIES) + 1; i <= MAX_VICTORIES; i++) {
+        rank += t->standings.victory_hist[i];
+    }
+    return rank;
+}
+
+// k лучших бойцов обходом дерева по убыванию (куча узлов), O(k log n)
+int standings_top(Standings* standings, int k, int* out) {
+    int heap[TOP_MAX * 64 + 1];  // на каждый извлеченный узел добавляется не больше двух
+    int size = 0;
+    int found = 0;
+    heap[size++] = 1;
+    
+    while (size > 0 && found < k) {
+        // извлечение узла с наибольшим ключом
+        int node = heap[0];
+        heap[0] = heap[--size];
+        for (int i = 0;;) {
+            int best = i;
+            for (int c = 2 * i + 1; c <= 2 * i + 2 && c < size; c++) {
+                if (standings_node(standings, heap[c]) > standings_node(standings, heap[best])) {
+                    best = c;
+                }
+            }
+            if (best == i) {
+                break;
+            }
+            int temp = heap[i];
+            heap[i] = heap[best];
+            heap[best] = temp;
+            i = best;
+        }
+        
+        uint64_t key = standings_node(standings, node);
+        if (key == 0) {
+            continue;  // пустое поддерево
+        }
+        if (node >= standings->leaves) {
+            out[found++] = standings_id(key);
+            continue;
+        }
+        
+        // добавление потомков
+        for (int c = 2 * node; c <= 2 * node + 1; c++) {
+            int i = size++;
+            heap[i] = c;
+            while (i > 0 && standings_node(standings, heap[i]) >
+                            standings_node(standings, heap[(i - 1) / 2])) {
+                int temp = heap[i];
+                heap[i] = heap[(i - 1) / 2];
+                heap[(i - 1) / 2] = temp;
+                i = (i - 1) / 2;
+            }
+        }
+    }
+    return found;
+}
+
+// вывод таблицы лидеров по победам без просмотра всей арены
+void print_standings(Tournament* t) {
+    if (t->top_count <= 0) {
+        return;
+    }
+    int ids[TOP_MAX];
+    int ranks[TOP_MAX];
+    int wins[TOP_MAX];
+    
+    stats_spin_lock(&t->standings.lock, tournament_lock_stats(t, LOCK_STANDINGS));
+    int count = standings_top(&t->standings, t->top_count, ids);
+    for (int i = 0; i < count; i++) {
+        ranks[i] = standings_rank(t, ids[i]);
+        wins[i] = atomic_load(&t->arena.fighters[ids[i]].victories);
+    }
+    pthread_spin_unlock(&t->standings.lock);
+    
+    print_output(t, "Лидеры по победам:");
+    for (int i = 0; i < count; i++) {
+        print_output(t, "%s %d) Боец %d - %d", i ? "," : "", ranks[i], ids[i], wins[i]);
+    }
+    print_output(t, "\n");
 }
 
 // функция определения победителя в бою
@@ -83,217 +1004,1916 @@ const char* gesture_name(HandSign sign) {
     }
 }
 
-// функция организации раунда
-void setup_round() {
-    pthread_spin_lock(&arena.arena_spinlock);  // захват спинлока
-    
-    if (atomic_load(&arena.finished)) {
-        pthread_spin_unlock(&arena.arena_spinlock);
-        return;
+// выбор жеста по весам: r — случайное число в диапазоне [0, сумма весов)
+HandSign pick_weighted(const unsigned int* weights, unsigned int r) {
+    if (r < weights[0]) {
+        return ROCK;
+    }
+    return r < weights[0] + weights[1] ? SCISSORS : PAPER;
+}
+
+// стратегия uniform: прежнее поведение бойца
+HandSign move_uniform(const StrategySpec* spec, const Combatant* self, unsigned int* seed) {
+    (void)spec;
+    (void)self;
+    return rand_r(seed) % 3;
+}
+
+// стратегия biased: жест по весам
+HandSign move_biased(const StrategySpec* spec, const Combatant* self, unsigned int* seed) {
+    (void)self;
+    return pick_weighted(spec->weights, rand_r(seed) % spec->row_total[0]);
+}
+
+// стратегия counter: бьет самый частый жест соперников, в трети случаев — случайный жест
+// (случайная доля не дает двум counter-бойцам бесконечно повторять ничьи)
+HandSign move_counter(const StrategySpec* spec, const Combatant* self, unsigned int* seed) {
+    (void)spec;
+    unsigned int r = rand_r(seed);
+    int best = self->seen[0] >= self->seen[1] ? 0 : 1;
+    best = self->seen[2] > self->seen[best] ? 2 : best;
+    if (r % 3 == 0 || self->seen[best] == 0) {
+        return (r / 3) % 3;
+    }
+    return (best + 2) % 3;  // жест, который бьет best
+}
+
+// стратегия markov: веса из строки своего прошлого жеста
+HandSign move_markov(const StrategySpec* spec, const Combatant* self, unsigned int* seed) {
+    int row = self->last_move;
+    return pick_weighted(&spec->weights[row * 3], rand_r(seed) % spec->row_total[row]);
+}
+
+// жест бойца по его стратегии (ветвление по виду; горячий цикл использует ядра боев)
+HandSign strategy_move(const Tournament* t, const Combatant* fighter, unsigned int* seed) {
+    const StrategySpec* spec = &t->strategies.specs[fighter->strategy];
+    switch (spec->kind) {
+        case STRAT_BIASED: return move_biased(spec, fighter, seed);
+        case STRAT_COUNTER: return move_counter(spec, fighter, seed);
+        case STRAT_MARKOV: return move_markov(spec, fighter, seed);
+        default: return move_uniform(spec, fighter, seed);
+    }
+}
+
+// вид стратегии бойца
+int strategy_kind(const Tournament* t, const Combatant* fighter) {
+    return t->strategies.specs[fighter->strategy].kind;
+}
+
+// название вида стратегии
+const char* strategy_name(StrategyKind kind) {
+    switch (kind) {
+        case STRAT_UNIFORM: return "uniform";
+        case STRAT_BIASED: return "biased";
+        case STRAT_COUNTER: return "counter";
+        case STRAT_MARKOV: return "markov";
+        default: return "unknown";
+    }
+}
+
+// стратегия бойца по ID: доли таблицы, бойцы перемешаны мультипликативным хешем
+int strategy_assign(const StrategyTable* table, int fighter_id) {
+    if (table->count <= 1) {
+        return 0;
+    }
+    uint32_t hash = (uint32_t)fighter_id * 2654435761u;
+    int point = (int)(((uint64_t)hash * table->share_total) >> 32);
+    for (int i = 0; i < table->count; i++) {
+        point -= table->specs[i].share;
+        if (point < 0) {
+            return i;
+        }
+    }
+    return table->count - 1;
+}
+
+// таблица по умолчанию: все бойцы играют uniform
+void strategies_default(StrategyTable* table) {
+    memset(table, 0, sizeof(StrategyTable));
+    table->specs[0].kind = STRAT_UNIFORM;
+    table->specs[0].share = 1;
+    table->count = 1;
+    table->share_total = 1;
+}
+
+// загрузка таблицы стратегий: строки "доля вид [веса]", # — комментарий
+// biased: 3 веса (Камень Ножницы Бумага); markov: 9 весов, строка = прошлый жест
+int load_strategies(StrategyTable* table, const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        perror("Ошибка открытия файла стратегий");
+        return 1;
+    }
+    
+    char line[STRATEGY_LINE_MAX];
+    int line_number = 0;
+    memset(table, 0, sizeof(StrategyTable));
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char name[16];
+        int share = 0;
+        int used = 0;
+        if (sscanf(line, " %n", &used) == 0 && (line[used] == '#' || line[used] == '\0')) {
+            continue;
+        }
+        if (sscanf(line, "%d %15s %n", &share, name, &used) < 2 || share <= 0) {
+            printf("Ошибка в файле стратегий, строка %d: ожидается \"доля вид [веса]\"\n",
+                   line_number);
+            fclose(file);
+            return 1;
+        }
+        if (table->count == STRATEGY_MAX) {
+            printf("Ошибка в файле стратегий: больше %d стратегий\n", STRATEGY_MAX);
+            fclose(file);
+            return 1;
+        }
+        
+        StrategySpec* spec = &table->specs[table->count];
+        int expected = 0;
+        if (strcmp(name, "uniform") == 0) {
+            spec->kind = STRAT_UNIFORM;
+        } else if (strcmp(name, "biased") == 0) {
+            spec->kind = STRAT_BIASED;
+            expected = 3;
+        } else if (strcmp(name, "counter") == 0) {
+            spec->kind = STRAT_COUNTER;
+        } else if (strcmp(name, "markov") == 0) {
+            spec->kind = STRAT_MARKOV;
+            expected = 9;
+        } else {
+            printf("Ошибка в файле стратегий, строка %d: неизвестная стратегия %s\n",
+                   line_number, name);
+            fclose(file);
+            return 1;
+        }
+        
+        // веса: каждая строка должна допускать хотя бы два жеста, иначе ничьи могут не кончиться
+        char* p = line + used;
+        for (int i = 0; i < expected; i++) {
+            char* end;
+            long weight = strtol(p, &end, 10);
+            if (end == p || weight < 0 || weight > 1000000) {
+                printf("Ошибка в файле стратегий, строка %d: нужно %d неотрицательных весов\n",
+                       line_number, expected);
+                fclose(file);
+                return 1;
+            }
+            spec->weights[i] = (unsigned int)weight;
+            spec->row_total[i / 3] += (unsigned int)weight;
+            p = end;
+        }
+        for (int row = 0; row < expected / 3; row++) {
+            const unsigned int* w = &spec->weights[row * 3];
+            if ((w[0] > 0) + (w[1] > 0) + (w[2] > 0) < 2) {
+                printf("Ошибка в файле стратегий, строка %d: в каждой тройке весов "
+                       "нужно хотя бы два ненулевых\n", line_number);
+                fclose(file);
+                return 1;
+            }
+        }
+        
+        spec->share = share;
+        table->share_total += share;
+        table->count++;
+    }
+    fclose(file);
+    
+    if (table->count == 0) {
+        printf("Файл стратегий %s не содержит стратегий\n", filename);
+        return 1;
+    }
+    return 0;
+}
+
+// постановка раунда в очередь пула; порции выдаются по мере публикации пар
+void coro_open_round(Tournament* t) {
+    t->batches_left = (t->arena.ready_count + CORO_BATCH - 1) / CORO_BATCH;
+    if (t->arena.ready_count == 0) {
+        return;
+    }
+    
+    coro_lock();
+    t->next_task = 0;
+    t->published = 0;
+    t->next_queued = NULL;
+    if (coro_pool.tail) {
+        coro_pool.tail->next_queued = t;
+    } else {
+        coro_pool.head = t;
+    }
+    coro_pool.tail = t;
+    pthread_mutex_unlock(&coro_pool.mutex);
+}
+
+// публикация пар раунда до позиции end списка ready_fighters
+void coro_publish(Tournament* t, int end) {
+    coro_lock();
+    t->published = end;
+    pthread_cond_signal(&coro_pool.work_cond);  // одна новая порция — один рабочий поток
+    pthread_mutex_unlock(&coro_pool.mutex);
+}
+
+// отмена неопубликованных порций раунда после сигнала: пул их не получит, раунд
+// завершается, как только доиграны уже опубликованные порции
+void coro_cancel_rest(Tournament* t) {
+    coro_lock();
+    int cancelled = (t->arena.ready_count - t->published + CORO_BATCH - 1) / CORO_BATCH;
+    t->arena.ready_count = t->published;
+    if (t->next_task >= t->published) {
+        // все опубликованные порции уже взяты: турнир покидает очередь здесь
+        Tournament* prev = NULL;
+        for (Tournament* q = coro_pool.head; q != t; q = q->next_queued) {
+            prev = q;  // турнир в очереди: его последняя порция еще не роздана
+        }
+        if (prev) {
+            prev->next_queued = t->next_queued;
+        } else {
+            coro_pool.head = t->next_queued;
+        }
+        if (coro_pool.tail == t) {
+            coro_pool.tail = prev;
+        }
+    }
+    pthread_mutex_unlock(&coro_pool.mutex);
+    
+    pthread_mutex_lock(&t->round_mutex);
+    t->batches_left -= cancelled;
+    if (t->batches_left == 0) {
+        pthread_cond_signal(&t->round_cond);
+    }
+    pthread_mutex_unlock(&t->round_mutex);
+}
+
+// ленивое создание бойца при первом назначении в бой (память пула уже обнулена)
+void fighter_materialize(Tournament* t, int id) {
+    Combatant* fighter = &t->arena.fighters[id];
+    if (fighter->materialized) {
+        return;
+    }
+    fighter->id = id;
+    atomic_store(&fighter->rival_id, -1);
+    fighter->seed = t->seed_base + id;  // seed зависит только от базы и ID
+    fighter->strategy = strategy_assign(&t->strategies, id);
+    fighter->materialized = 1;
+}
+
+// отметка первого обмена жестами турнира (время до первого боя)
+void mark_first_duel(Tournament* t) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long elapsed = (now.tv_sec - t->start_time.tv_sec) * 1000000000LL +
+                        (now.tv_nsec - t->start_time.tv_nsec);
+    long long expected = 0;
+    atomic_compare_exchange_strong(&t->first_duel_ns, &expected, elapsed > 0 ? elapsed : 1);
+}
+
+// ячейка списка готовых бойцов для позиции перемешивания: перемешивание идет с конца,
+// а пул берет пары с начала, поэтому первые paired_count позиций лежат в обратном порядке
+int ready_slot(int pos, int paired_count) {
+    return pos < paired_count ? paired_count - 1 - pos : pos;
+}
+
+// элемент списка готовых бойцов по позиции перемешивания; в первом раунде хранится ID + 1,
+// а 0 — боец с ID позиции
+int ready_get(const int* ready_fighters, int pos, int paired_count, int lazy) {
+    int value = ready_fighters[ready_slot(pos, paired_count)];
+    if (!lazy) {
+        return value;
+    }
+    return value ? value - 1 : pos;
+}
+
+// шаг Фишера-Йетса с конца списка: после него позиция step окончательна
+void ready_shuffle_step(Tournament* t, int step, int paired_count, int lazy) {
+    int* ready_fighters = t->arena.ready_fighters;
+    int j = rand_r(&t->pairing_seed) % (step + 1);
+    int temp = ready_get(ready_fighters, step, paired_count, lazy);
+    int other = ready_get(ready_fighters, j, paired_count, lazy);
+    ready_fighters[ready_slot(j, paired_count)] = lazy ? temp + 1 : temp;
+    ready_fighters[ready_slot(step, paired_count)] = lazy ? other + 1 : other;
+}
+
+// функция организации раунда; строка пары выводится до установки флагов боя и публикации
+// порции, поэтому в выводе пара всегда предшествует своему бою
+void setup_round(Tournament* t) {
+    Arena* arena = &t->arena;
+    stats_spin_lock(&arena->arena_spinlock, tournament_lock_stats(t, LOCK_ARENA));
+    
+    arena->ready_count = 0;
+    if (atomic_load(&arena->finished)) {
+        pthread_spin_unlock(&arena->arena_spinlock);
+        return;
+    }
+    
+    atomic_store(&arena->round_started, 1);  // устанавливаем флаг начала раунда
+    
+    // сбор активных бойцов без соперника: по 64 бойца за слово
+    // в первом раунде готовы все по порядку ID: список не собирается (см. ready_get)
+    int* ready_fighters = arena->ready_fighters;
+    int lazy = atomic_load(&arena->round_num) == 0;
+    int count = lazy ? arena->total_count : 0;
+    for (int w = 0; w < arena->bit_words && !lazy; w++) {
+        uint64_t bits = atomic_load(&arena->alive_bits[w]) & ~atomic_load(&arena->duel_bits[w]);
+        while (bits) {
+            ready_fighters[count++] = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+    }
+    
+    int paired_count = count & ~1;  // боец без пары остается в конце списка
+    for (int i = 0; i < paired_count / 2 && !lazy; i++) {
+        int temp = ready_fighters[i];  // порядок ячеек см. ready_slot
+        ready_fighters[i] = ready_fighters[paired_count - 1 - i];
+        ready_fighters[paired_count - 1 - i] = temp;
+    }
+    
+    atomic_fetch_add(&arena->round_num, 1);  // атомарное увеличение номера раунда
+    arena->ready_count = paired_count;
+    print_output(t, "Начало раунда %d. Бойцов готово к бою: %d\n",
+                 atomic_load(&arena->round_num), count);
+    if (t->engine == ENGINE_CORO) {
+        coro_open_round(t);  // пул забирает порции по мере формирования пар
+    }
+    
+    // перемешивание Фишера-Йетса с конца списка: позиции pos и pos + 1 окончательны после
+    // шагов pos + 1 и pos, поэтому пара формируется сразу, не дожидаясь остальных
+    if (count > paired_count && count > 1) {
+        ready_shuffle_step(t, count - 1, paired_count, lazy);
+    }
+    int paired = 0;  // сколько ячеек списка разбито на пары
+    for (int pos = paired_count - 2; pos >= 0; pos -= 2) {
+        int i = paired_count - 2 - pos;  // ячейка пары в списке пула
+        // после сигнала новые порции не формируются: дренируются только уже выданные бои
+        if (i % CORO_BATCH == 0 && stop_requested()) {
+            break;
+        }
+        paired = i + 2;
+        for (int step = pos + 1; step >= pos && step > 0; step--) {
+            ready_shuffle_step(t, step, paired_count, lazy);
+        }
+        int fighter1 = ready_get(ready_fighters, pos, paired_count, lazy);
+        int fighter2 = ready_get(ready_fighters, pos + 1, paired_count, lazy);
+        ready_fighters[i] = fighter1;  // пул читает окончательные ID
+        ready_fighters[i + 1] = fighter2;
+        fighter_materialize(t, fighter1);
+        fighter_materialize(t, fighter2);
+        
+        // событие пишется до установки флагов, чтобы бой не попал в запись раньше пары
+        record_event(t, EV_PAIR, fighter1, fighter2, 0, 0, 0);
+        print_output(t, "Организован бой: Боец %d vs Боец %d\n", fighter1, fighter2);
+        
+        // соперник записывается до флага боя: поток, увидевший флаг, видит и rival_id
+        atomic_store(&arena->fighters[fighter1].rival_id, fighter2);
+        atomic_store(&arena->fighters[fighter2].rival_id, fighter1);
+        fighter_set_duel(arena, fighter1, 1);
+        fighter_set_duel(arena, fighter2, 1);
+        
+        // публикация готовой порции пар (CORO_BATCH четный => пары не разрываются)
+        if (t->engine == ENGINE_CORO && ((i + 2) % CORO_BATCH == 0 || i + 2 == arena->ready_count)) {
+            coro_publish(t, i + 2);
+        }
+    }
+    
+    if (t->engine == ENGINE_CORO && paired < arena->ready_count) {
+        coro_cancel_rest(t);
+    }
+    pthread_spin_unlock(&arena->arena_spinlock);  // освобождение спинлока
+}
+
+// начало боя ведущим бойцом: проверка соперника, бой проводит боец с меньшим ID
+// возвращает 0, если бойцу вести нечего
+int duel_begin(Tournament* t, int fighter_id) {
+    Arena* arena = &t->arena;
+    Combatant* self = &arena->fighters[fighter_id];
+    if (!fighter_alive(arena, fighter_id) || !fighter_in_duel(arena, fighter_id)) {
+        return 0;
+    }
+    
+    int rival_id = atomic_load(&self->rival_id);
+    if (rival_id < 0 || rival_id >= arena->total_count ||
+        !fighter_alive(arena, rival_id) || fighter_id > rival_id) {
+        fighter_set_duel(arena, fighter_id, 0);
+        atomic_store(&self->rival_id, -1);
+        return 0;
+    }
+    
+    self->duel_rounds = 0;
+    return 1;
+}
+
+// запоминание жестов обмена в состоянии стратегий обоих бойцов
+void strategy_observe(Combatant* self, Combatant* rival, HandSign my_move, HandSign rival_move) {
+    self->last_move = my_move;
+    rival->last_move = rival_move;
+    if (self->seen[rival_move] < UINT16_MAX) {
+        self->seen[rival_move]++;
+    }
+    if (rival->seen[my_move] < UINT16_MAX) {
+        rival->seen[my_move]++;
+    }
+}
+
+// один обмен жестами в бою ведущего бойца; возвращает 1 при ничьей
+int duel_exchange(Tournament* t, int fighter_id, HandSign my_move, HandSign rival_move) {
+    Arena* arena = &t->arena;
+    Combatant* self = &arena->fighters[fighter_id];
+    int rival_id = atomic_load(&self->rival_id);
+    HandSign winner_move = get_winner(my_move, rival_move);
+    self->duel_rounds++;
+    if (atomic_load_explicit(&t->first_duel_ns, memory_order_relaxed) == 0) {
+        mark_first_duel(t);
+    }
+    strategy_observe(self, &arena->fighters[rival_id], my_move, rival_move);
+    
+    if (winner_move == (HandSign)-1) {
+        print_output(t, "Бой %d vs %d (раунд %d): %s vs %s => Ничья\n",
+            fighter_id, rival_id, self->duel_rounds,
+            gesture_name(my_move), gesture_name(rival_move));
+        record_event(t, EV_DUEL, fighter_id, rival_id, -1, my_move, rival_move);
+        return 1;
+    }
+    
+    int winner_id = winner_move == my_move ? fighter_id : rival_id;
+    int loser_id = winner_id == fighter_id ? rival_id : fighter_id;
+    print_output(t, "Бой %d vs %d (раунд %d): %s vs %s => Победил Боец %d\n",
+        fighter_id, rival_id, self->duel_rounds,
+        gesture_name(my_move), gesture_name(rival_move), winner_id);
+    record_event(t, EV_DUEL, fighter_id, rival_id, winner_id, my_move, rival_move);
+    // атомарные операции обновления состояния
+    standings_add_victory(t, winner_id);
+    log_duel(t, fighter_id, rival_id, winner_id, self->duel_rounds - 1);
+    fighter_eliminate(arena, loser_id);
+    atomic_fetch_sub(&arena->alive_count, 1);
+    
+    // сброс флагов соперничества после боя
+    fighter_set_duel(arena, fighter_id, 0);
+    atomic_store(&self->rival_id, -1);
+    fighter_set_duel(arena, rival_id, 0);
+    atomic_store(&arena->fighters[rival_id].rival_id, -1);
+    return 0;
+}
+
+// функция потока-бойца
+void* fighter_thread(void* arg) {
+    Tournament* t = ((FighterArg*)arg)->t;
+    int fighter_id = ((FighterArg*)arg)->fighter_id;
+    round_owner = t;  // поток бойца целиком работает в раундах
+    Arena* arena = &t->arena;
+    
+    Combatant* self = &arena->fighters[fighter_id];
+    
+    // стартовый барьер: главный поток ждет, пока все бойцы не будут готовы
+    pthread_mutex_lock(&t->round_mutex);
+    t->threads_ready++;
+    pthread_cond_signal(&t->round_cond);
+    pthread_mutex_unlock(&t->round_mutex);
+    
+    while (1) {
+        if (atomic_load(&arena->finished)) {
+            break;
+        }
+        
+        if (!fighter_alive(arena, fighter_id)) {
+            usleep(10000);
+            continue;
+        }
+        
+        // ожидание начала раунда с timeout
+        int timeout_counter = 10000;
+        while (atomic_load(&arena->round_started) == 0 && 
+            !atomic_load(&arena->finished) && timeout_counter > 0) {
+            usleep(1000);
+            timeout_counter--;
+        }
+        
+        if (timeout_counter <= 0 && atomic_load(&arena->round_started) == 0) {
+            print_output(t, "Боец %d: timeout ожидания раунда\n", fighter_id);
+            break;
+        }
+        
+        if (atomic_load(&arena->finished)) {
+            break;
+        }
+        
+        // если у бойца есть соперник
+        if (fighter_in_duel(arena, fighter_id)) {
+            int rival_id = atomic_load(&arena->fighters[fighter_id].rival_id);
+            
+            // проверка корректности соперника
+            if (rival_id < 0 || rival_id >= arena->total_count ||
+                !fighter_alive(arena, rival_id)) {
+                fighter_set_duel(arena, fighter_id, 0);
+                atomic_store(&arena->fighters[fighter_id].rival_id, -1);
+                continue;
+            }
+            
+            // гарантируем, что бой проводит боец с меньшим ID
+            if (fighter_id > rival_id) {
+                fighter_set_duel(arena, fighter_id, 0);
+                atomic_store(&arena->fighters[fighter_id].rival_id, -1);
+                continue;
+            }
+            
+            // цикл боя (повторяется при ничьей); оба жеста от генератора ведущего бойца
+            int draw;
+            self->duel_rounds = 0;
+            do {
+                HandSign my_move = strategy_move(t, self, &self->seed);
+                HandSign rival_move = strategy_move(t, &arena->fighters[rival_id], &self->seed);
+                draw = duel_exchange(t, fighter_id, my_move, rival_move);
+                if (draw && !stop_requested()) {
+                    usleep(300000);  // пауза перед следующим раундом боя
+                }
+            } while (draw &&
+                     fighter_alive(arena, fighter_id) &&
+                     fighter_alive(arena, rival_id));
+            
+            // сброс флагов соперничества после боя
+            fighter_set_duel(arena, fighter_id, 0);
+            atomic_store(&arena->fighters[fighter_id].rival_id, -1);
+            fighter_set_duel(arena, rival_id, 0);
+            atomic_store(&arena->fighters[rival_id].rival_id, -1);
+        }
+        
+        usleep(10000);  // пауза для снижения нагрузки на CPU
+    }
+    
+    print_output(t, "Боец %d завершил участие.\n", fighter_id);
+    return NULL;
+}
+
+// ядро боев одной пары видов стратегий: виды известны при компиляции, ветвления по виду нет
+// conductors — ведущие бойцы, бои с ничьей остаются в списке до следующего прохода
+typedef void (*DuelKernel)(Tournament* t, int* conductors, int count);
+
+#define DUEL_KERNEL(name, MOVE_A, MOVE_B) \
+void name(Tournament* t, int* conductors, int count) { \
+    Combatant* fighters = t->arena.fighters; \
+    const StrategySpec* specs = t->strategies.specs; \
+    while (count > 0 && !atomic_load(&t->arena.finished)) { \
+        int kept = 0; \
+        for (int i = 0; i < count; i++) { \
+            Combatant* self = &fighters[conductors[i]]; \
+            Combatant* rival = &fighters[atomic_load(&self->rival_id)]; \
+            HandSign my_move = MOVE_A(&specs[self->strategy], self, &self->seed); \
+            HandSign rival_move = MOVE_B(&specs[rival->strategy], rival, &self->seed); \
+            if (duel_exchange(t, conductors[i], my_move, rival_move)) { \
+                conductors[kept++] = conductors[i]; \
+            } \
+        } \
+        count = kept; \
+    } \
+}
+
+#define DUEL_KERNELS_FOR(kind) \
+    DUEL_KERNEL(duel_##kind##_uniform, move_##kind, move_uniform) \
+    DUEL_KERNEL(duel_##kind##_biased, move_##kind, move_biased) \
+    DUEL_KERNEL(duel_##kind##_counter, move_##kind, move_counter) \
+    DUEL_KERNEL(duel_##kind##_markov, move_##kind, move_markov)
+
+DUEL_KERNELS_FOR(uniform)
+DUEL_KERNELS_FOR(biased)
+DUEL_KERNELS_FOR(counter)
+DUEL_KERNELS_FOR(markov)
+
+// ядра по видам стратегий [ведущий][соперник] (порядок как в StrategyKind)
+DuelKernel duel_kernels[STRATEGY_KINDS][STRATEGY_KINDS] = {
+    { duel_uniform_uniform, duel_uniform_biased, duel_uniform_counter, duel_uniform_markov },
+    { duel_biased_uniform, duel_biased_biased, duel_biased_counter, duel_biased_markov },
+    { duel_counter_uniform, duel_counter_biased, duel_counter_counter, duel_counter_markov },
+    { duel_markov_uniform, duel_markov_biased, duel_markov_counter, duel_markov_markov }
+};
+
+// рабочий поток общего пула: берет порции бойцов любого турнира из очереди
+void* coro_worker(void* arg) {
+    (void)arg;
+    int buckets[STRATEGY_KINDS * STRATEGY_KINDS][CORO_BATCH / 2];
+    int bucket_size[STRATEGY_KINDS * STRATEGY_KINDS];
+    
+    pthread_mutex_lock(&coro_pool.mutex);
+    coro_pool.ready++;  // стартовый барьер пула
+    pthread_cond_signal(&coro_pool.ready_cond);
+    while (1) {
+        // первый турнир очереди, у которого есть опубликованная и не взятая порция
+        Tournament* prev = NULL;
+        Tournament* t = coro_pool.head;
+        while (t && t->next_task >= t->published) {
+            prev = t;
+            t = t->next_queued;
+        }
+        if (!t) {
+            if (coro_pool.shutdown) {
+                break;  // порций нет и пул остановлен
+            }
+            pthread_cond_wait(&coro_pool.work_cond, &coro_pool.mutex);
+            continue;
+        }
+        
+        // захват порции; турнир покидает очередь после раздачи последней порции раунда
+        int start = t->next_task;
+        int end = start + CORO_BATCH;
+        if (end >= t->arena.ready_count) {
+            end = t->arena.ready_count;
+            if (prev) {
+                prev->next_queued = t->next_queued;
+            } else {
+                coro_pool.head = t->next_queued;
+            }
+            if (coro_pool.tail == t) {
+                coro_pool.tail = prev;
+            }
+        }
+        t->next_task = end;
+        pthread_mutex_unlock(&coro_pool.mutex);
+        round_owner = t;
+        
+        // пары идут подряд, а CORO_BATCH четный => оба бойца пары в одной порции
+        // бои группируются по паре видов стратегий до горячего цикла
+        // порция, взятая после сигнала, не начинается, а только учитывается в batches_left
+        if (stop_requested()) {
+            end = start;
+        }
+        memset(bucket_size, 0, sizeof(bucket_size));
+        Combatant* fighters = t->arena.fighters;
+        for (int i = start; i + 1 < end; i += 2) {
+            int fighter1 = t->arena.ready_fighters[i];
+            int fighter2 = t->arena.ready_fighters[i + 1];
+            int conductor = fighter1 < fighter2 ? fighter1 : fighter2;
+            int rival = fighter1 < fighter2 ? fighter2 : fighter1;
+            if (!duel_begin(t, conductor)) {
+                continue;
+            }
+            int key = strategy_kind(t, &fighters[conductor]) * STRATEGY_KINDS +
+                      strategy_kind(t, &fighters[rival]);
+            buckets[key][bucket_size[key]++] = conductor;
+        }
+        
+        // каждая группа проводится своим ядром, пока в ней есть незавершенные бои
+        for (int key = 0; key < STRATEGY_KINDS * STRATEGY_KINDS; key++) {
+            if (bucket_size[key] > 0) {
+                duel_kernels[key / STRATEGY_KINDS][key % STRATEGY_KINDS](
+                    t, buckets[key], bucket_size[key]);
+            }
+        }
+        
+        // последняя обработанная порция будит поток, ведущий турнир
+        round_owner = NULL;
+        pthread_mutex_lock(&t->round_mutex);
+        if (--t->batches_left == 0) {
+            pthread_cond_signal(&t->round_cond);
+        }
+        pthread_mutex_unlock(&t->round_mutex);
+        
+        coro_lock();
+    }
+    pthread_mutex_unlock(&coro_pool.mutex);
+    return NULL;
+}
+
+// запуск общего пула рабочих потоков
+int coro_start(int workers) {
+    memset(&coro_pool, 0, sizeof(CoroPool));
+    pthread_mutex_init(&coro_pool.mutex, NULL);
+    pthread_cond_init(&coro_pool.work_cond, NULL);
+    pthread_cond_init(&coro_pool.ready_cond, NULL);
+    
+    coro_pool.threads = calloc(workers, sizeof(pthread_t));
+    if (!coro_pool.threads) {
+        return -1;
+    }
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&coro_pool.threads[i], NULL, coro_worker, NULL) != 0) {
+            return -1;
+        }
+        coro_pool.count++;
+    }
+    
+    // стартовый барьер: возврат, как только все рабочие потоки готовы
+    pthread_mutex_lock(&coro_pool.mutex);
+    while (coro_pool.ready < coro_pool.count) {
+        pthread_cond_wait(&coro_pool.ready_cond, &coro_pool.mutex);
+    }
+    pthread_mutex_unlock(&coro_pool.mutex);
+    return 0;
+}
+
+// ожидание завершения всех боев раунда на общем пуле
+void coro_run_round(Tournament* t) {
+    if (t->arena.ready_count == 0) {
+        return;
+    }
+    pthread_mutex_lock(&t->round_mutex);
+    while (t->batches_left > 0) {
+        pthread_cond_wait(&t->round_cond, &t->round_mutex);
+    }
+    pthread_mutex_unlock(&t->round_mutex);
+}
+
+// остановка общего пула рабочих потоков
+void coro_stop() {
+    if (!coro_pool.threads) {
+        return;
+    }
+    pthread_mutex_lock(&coro_pool.mutex);
+    coro_pool.shutdown = 1;
+    pthread_cond_broadcast(&coro_pool.work_cond);
+    pthread_mutex_unlock(&coro_pool.mutex);
+    
+    for (int i = 0; i < coro_pool.count; i++) {
+        pthread_join(coro_pool.threads[i], NULL);
+    }
+    
+    pthread_mutex_destroy(&coro_pool.mutex);
+    pthread_cond_destroy(&coro_pool.work_cond);
+    pthread_cond_destroy(&coro_pool.ready_cond);
+    free(coro_pool.threads);
+    coro_pool.threads = NULL;
+}
+
+// раунд малой сетки целиком на текущем потоке: живые бойцы — одно 64-битное слово, пары
+// и бои без блокировок и пауз; генераторы расходуются в том же порядке, что в setup_round()
+// и fighter_thread(), поэтому при том же seed итог совпадает с движком threads
+void small_round(Tournament* t) {
+    Arena* arena = &t->arena;
+    Combatant* fighters = arena->fighters;
+    uint8_t ready[SMALL_MAX_FIGHTERS];
+    int count = 0;
+    for (uint64_t bits = atomic_load(&arena->alive_bits[0]); bits; bits &= bits - 1) {
+        ready[count++] = __builtin_ctzll(bits);
+    }
+    atomic_fetch_add(&arena->round_num, 1);
+    arena->ready_count = count & ~1;
+    print_output(t, "Начало раунда %d. Бойцов готово к бою: %d\n",
+                 atomic_load(&arena->round_num), count);
+    
+    // перемешивание Фишера-Йетса с конца списка (те же шаги, что в setup_round())
+    for (int i = count - 1; i > 0; i--) {
+        int j = rand_r(&t->pairing_seed) % (i + 1);
+        uint8_t temp = ready[i];
+        ready[i] = ready[j];
+        ready[j] = temp;
+    }
+    // пары с конца списка, как в setup_round(): строки и события пар совпадают с threads
+    for (int i = arena->ready_count - 2; i >= 0; i -= 2) {
+        fighter_materialize(t, ready[i]);
+        fighter_materialize(t, ready[i + 1]);
+        record_event(t, EV_PAIR, ready[i], ready[i + 1], 0, 0, 0);
+        print_output(t, "Организован бой: Боец %d vs Боец %d\n", ready[i], ready[i + 1]);
+    }
+    
+    // бои по порядку пар; ведет боец с меньшим ID, оба жеста от его генератора
+    for (int i = arena->ready_count - 2; i >= 0; i -= 2) {
+        int conductor = ready[i] < ready[i + 1] ? ready[i] : ready[i + 1];
+        int rival = ready[i] ^ ready[i + 1] ^ conductor;
+        Combatant* self = &fighters[conductor];
+        atomic_store(&self->rival_id, rival);
+        self->duel_rounds = 0;
+        int draw;
+        do {
+            HandSign my_move = strategy_move(t, self, &self->seed);
+            HandSign rival_move = strategy_move(t, &fighters[rival], &self->seed);
+            draw = duel_exchange(t, conductor, my_move, rival_move);
+        } while (draw);
+    }
+}
+
+// функция вывода списка активных бойцов
+void print_active_fighters(Tournament* t) {
+    Arena* arena = &t->arena;
+    print_output(t, "\nПромежуточные победители: ");
+    int first = 1;
+    for (int w = 0; w < arena->bit_words; w++) {
+        uint64_t bits = atomic_load(&arena->alive_bits[w]);
+        while (bits) {
+            print_output(t, first ? "Боец %d" : ", Боец %d", w * 64 + __builtin_ctzll(bits));
+            bits &= bits - 1;
+            first = 0;
+        }
+    }
+    print_output(t, "\n");
+}
+
+// настройки турнира по умолчанию
+void tournament_defaults(Tournament* t) {
+    memset(t, 0, sizeof(Tournament));
+    t->engine = ENGINE_THREADS;
+    t->top_count = 3;
+    t->console_echo = 1;
+    t->output_sink.fd = -1;
+    strategies_default(&t->strategies);
+    pthread_mutex_init(&t->buffer_mutex, NULL);
+}
+
+// подготовка турнира: seed, арена, таблица лидеров, потоки-бойцы
+// возвращает 0 при успехе; при ошибке ресурсы освобождает cleanup()
+int tournament_setup(Tournament* t) {
+    Arena* arena = &t->arena;
+    int fighter_count = t->fighter_count;
+    if (t->start_time.tv_sec == 0 && t->start_time.tv_nsec == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &t->start_time);  // main мог отметить начало раньше
+    }
+    
+    // инициализация генераторов случайных чисел турнира
+    if (t->use_custom_seed) {
+        t->seed_base = (unsigned int)t->custom_seed;
+        print_output(t, "Используется фиксированный seed: %d\n", t->custom_seed);
+    } else {
+        // счетчик различает турниры, начатые в одну секунду
+        t->seed_base = (unsigned int)time(NULL) ^ (unsigned int)getpid() ^
+                       (atomic_fetch_add(&seed_counter, 1) * 2654435761u);
+    }
+    t->pairing_seed = t->seed_base;
+    
+    print_output(t, "--- Турнир \"Камень-Ножницы-Бумага\" ---\n");
+    print_output(t, "Количество участников: %d\n", fighter_count);
+    // seed_base, а не custom_seed: запись прогона без -seed тоже воспроизводима
+    record_event(t, EV_START, fighter_count, (int32_t)t->seed_base, t->use_custom_seed, 0, 0);
+    
+    // инициализация арены турнира
+    memset(arena, 0, sizeof(Arena));
+    arena->total_count = fighter_count;
+    atomic_store(&arena->alive_count, fighter_count);
+    atomic_store(&arena->round_num, 0);
+    atomic_store(&arena->finished, 0);
+    atomic_store(&arena->round_started, 0);
+    pthread_spin_init(&arena->arena_spinlock, PTHREAD_PROCESS_PRIVATE);
+    pthread_mutex_init(&t->round_mutex, NULL);
+    pthread_cond_init(&t->round_cond, NULL);
+    arena->fighters = pool_alloc(t->pool, fighter_count * sizeof(Combatant));
+    arena->ready_fighters = pool_alloc(t->pool, fighter_count * sizeof(int));
+    arena->bit_words = (fighter_count + 63) / 64;
+    arena->alive_bits = pool_alloc(t->pool, arena->bit_words * sizeof(uint64_t));
+    arena->duel_bits = pool_alloc(t->pool, arena->bit_words * sizeof(uint64_t));
+    if (!arena->fighters || !arena->ready_fighters || !arena->alive_bits || !arena->duel_bits) {
+        printf("Ошибка выделения памяти для арены\n");
+        return 1;
+    }
+    
+    // все бойцы живы: полные слова + хвост последнего слова
+    for (int w = 0; w < arena->bit_words; w++) {
+        int bits = fighter_count - w * 64;
+        atomic_store(&arena->alive_bits[w], bits >= 64 ? ~0ULL : (1ULL << bits) - 1);
+    }
+    
+    // бойцы не инициализируются здесь: fighter_materialize() создает их при первом назначении в бой
+    
+    if (t->strategies.count > 1) {
+        print_output(t, "Стратегии бойцов:");
+        for (int i = 0; i < t->strategies.count; i++) {
+            print_output(t, "%s %s %d/%d", i ? "," : "",
+                         strategy_name(t->strategies.specs[i].kind),
+                         t->strategies.specs[i].share, t->strategies.share_total);
+        }
+        print_output(t, "\n");
+    }
+    
+    if (standings_init(&t->standings, t->pool, fighter_count) != 0) {
+        printf("Ошибка выделения памяти для таблицы лидеров\n");
+        return 1;
+    }
+    
+    // журнал боев нужен только для хранилища; решенных боев не больше fighter_count - 1
+    if (t->store_dir) {
+        DuelLog* log = &t->duel_log;
+        log->fighter_a = pool_alloc(t->pool, fighter_count * sizeof(int32_t));
+        log->fighter_b = pool_alloc(t->pool, fighter_count * sizeof(int32_t));
+        log->winner = pool_alloc(t->pool, fighter_count * sizeof(int32_t));
+        log->draws = pool_alloc(t->pool, fighter_count * sizeof(uint16_t));
+        atomic_store(&log->count, 0);
+        if (!log->fighter_a || !log->fighter_b || !log->winner || !log->draws) {
+            printf("Ошибка выделения памяти для журнала боев\n");
+            return 1;
+        }
+    }
+    
+    if (t->engine == ENGINE_CORO) {
+        // бои проводятся порциями на общем пуле потоков, своих потоков у бойцов нет
+        print_output(t, "Запуск %d рабочих потоков для %d бойцов...\n",
+                     coro_pool.count, fighter_count);
+        return 0;
+    }
+    if (t->engine == ENGINE_SMALL) {
+        return 0;  // малая сетка проводится на потоке, ведущем турнир
+    }
+    
+    t->fighter_threads = pool_alloc(t->pool, fighter_count * sizeof(pthread_t));
+    FighterArg* fighter_args = pool_alloc(t->pool, fighter_count * sizeof(FighterArg));
+    if (!t->fighter_threads || !fighter_args) {
+        printf("Ошибка выделения памяти для потоков\n");
+        return 1;
+    }
+    
+    // создание потоков-бойцов
+    for (int i = 0; i < fighter_count; i++) {
+        fighter_args[i].t = t;
+        fighter_args[i].fighter_id = i;
+        if (pthread_create(&t->fighter_threads[i], NULL, fighter_thread, &fighter_args[i]) != 0) {
+            perror("Ошибка создания потока");
+            return 1;
+        }
+    }
+    
+    // стартовый барьер: раунды начинаются, как только все потоки готовы
+    pthread_mutex_lock(&t->round_mutex);
+    while (t->threads_ready < fighter_count) {
+        pthread_cond_wait(&t->round_cond, &t->round_mutex);
+    }
+    pthread_mutex_unlock(&t->round_mutex);
+    print_output(t, "Потоков-бойцов готово: %d\n", fighter_count);
+    return 0;
+}
+
+// пауза на ms миллисекунд, прерываемая запросом остановки
+void pause_unless_stopped(int ms) {
+    for (int waited = 0; waited < ms && !stop_requested(); waited += 10) {
+        usleep(10000);
+    }
+}
+
+// строка статистики ожидания одной блокировки
+void print_lock_stats(Tournament* t, const char* name, LockStats* stats) {
+    print_output(t, "Ожидание блокировки %s: захватов %ld, с ожиданием %ld, "
+                 "p99 %.1f мкс, p99 ждавших %.1f мкс, max %.1f мкс\n", name,
+                 atomic_load(&stats->acquired), atomic_load(&stats->contended),
+                 lock_stats_quantile(stats, 0.99, 0) / 1e3, lock_stats_quantile(stats, 0.99, 1) / 1e3,
+                 atomic_load(&stats->max_ns) / 1e3);
+}
+
+// отчет -stats: пропускная способность, зависания раундов, ожидание блокировок
+void print_stats(Tournament* t, long long run_ns) {
+    int duels = t->fighter_count - atomic_load(&t->arena.alive_count);
+    print_output(t, "Статистика: боев %d за %.3f с, %.1f боев/с, самый долгий раунд %.1f мс\n",
+                 duels, run_ns / 1e9, run_ns > 0 ? duels * 1e9 / run_ns : 0.0,
+                 t->max_round_ns / 1e6);
+    print_output(t, "Зависания раундов: дополнительных ожиданий %d, брошено по max_waits %d\n",
+                 t->stall_waits, t->stalled_rounds);
+    print_lock_stats(t, "арены", &t->lock_stats[LOCK_ARENA]);
+    print_lock_stats(t, "таблицы лидеров", &t->lock_stats[LOCK_STANDINGS]);
+    if (t->engine == ENGINE_CORO && coro_pool.collect_stats) {
+        print_lock_stats(t, "пула", &coro_pool.lock_stats);
+    }
+}
+
+// проведение турнира: раунды до одного выжившего и вывод победителя
+void run_tournament(Tournament* t) {
+    Arena* arena = &t->arena;
+    round_owner = t;
+    long long run_start = monotonic_ns();
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    t->setup_ns = (now.tv_sec - t->start_time.tv_sec) * 1000000000LL +
+                  (now.tv_nsec - t->start_time.tv_nsec);
+    print_output(t, "\n------ Турнир начинается! ------\n");
+    
+    // главный цикл
+    int round = 0;
+    while (!atomic_load(&arena->finished)) {
+        int active = atomic_load(&arena->alive_count);
+        
+        if (active <= 1) {
+            atomic_store(&arena->finished, 1);
+            break;
+        }
+        
+        // после сигнала новый раунд не начинается: бои прошлого раунда уже завершены
+        if (stop_requested()) {
+            print_output(t, "\nТурнир остановлен по сигналу после раунда %d, бойцов осталось: %d\n",
+                         round, active);
+            break;
+        }
+        
+        print_output(t, "\n--- Раунд %d ---\n", ++round);
+        print_output(t, "Активных бойцов: %d\n", active);
+        record_event(t, EV_ROUND, round, active, 0, 0, 0);
+        
+        atomic_store(&arena->round_started, 0); // сброс флага начала раунда
+        long long round_start = monotonic_ns();
+        if (t->engine == ENGINE_SMALL) {
+            small_round(t);  // пары и бои раунда без потоков
+        } else {
+            setup_round(t);  // организация раунда
+        }
+        
+        if (t->engine == ENGINE_CORO) {
+            coro_run_round(t);  // возврат после завершения всех боев раунда
+        } else if (t->engine == ENGINE_THREADS) {
+            pause_unless_stopped(2000);  // пауза между раундами
+            
+            // ожидание завершения всех боев в раунде (после сигнала — частый опрос до дренажа)
+            int duels_active;
+            int max_waits = 30;
+            do {
+                duels_active = 0;
+                for (int w = 0; w < arena->bit_words && !duels_active; w++) {
+                    duels_active = atomic_load(&arena->duel_bits[w]) != 0;
+                }
+                if (duels_active && stop_requested()) {
+                    usleep(10000);
+                } else if (duels_active) {
+                    pause_unless_stopped(1000);
+                    max_waits--;
+                    t->stall_waits++;
+                }
+            } while (duels_active && max_waits > 0);
+            if (duels_active) {
+                t->stalled_rounds++;  // раунд брошен с незавершенными боями
+            }
+        }
+        long long round_ns = monotonic_ns() - round_start;
+        if (round_ns > t->max_round_ns) {
+            t->max_round_ns = round_ns;
+        }
+        
+        print_active_fighters(t);  // вывод промежуточных результатов
+        print_standings(t);  // таблица лидеров по турнирному дереву
+    }
+    
+    atomic_store(&arena->finished, 1);
+    atomic_store(&arena->round_started, 1);
+    
+    // определение и вывод победителя (прерванный турнир победителя не имеет)
+    int winner = atomic_load(&arena->alive_count) == 1 ? first_alive(arena) : -1;
+    if (winner >= 0) {
+        print_output(t, "\nТурнир завершен! Победитель: Боец %d\n", winner);
+        if (t->strategies.count > 1) {
+            print_output(t, "Стратегия победителя: %s\n",
+                         strategy_name(strategy_kind(t, &arena->fighters[winner])));
+        }
+        record_event(t, EV_FINISH, winner, 0, 0, 0, 0);
+    } else {
+        print_output(t, "\nТурнир завершен! Победитель не определен.\n");
+        record_event(t, EV_FINISH, -1, 0, 0, 0, 0);
+    }
+    
+    int leader = standings_id(standings_node(&t->standings, 1));
+    print_output(t, "Больше всего побед: Боец %d (%d)\n",
+                 leader, atomic_load(&arena->fighters[leader].victories));
+    print_output(t, "Все бои завершены.\n");
+    if (ALLOC_COUNTER) {
+        print_output(t, "Память прогона: %.1f МБ в пуле, выделений в куче во время раундов: %ld\n",
+                     t->pool->used / 1048576.0, atomic_load(&t->round_allocations));
+    }
+    long long first_duel_ns = atomic_load(&t->first_duel_ns);
+    if (first_duel_ns > 0) {
+        print_output(t, "Время до первого боя: %.3f мс (подготовка %.3f мс)\n",
+                     first_duel_ns / 1e6, t->setup_ns / 1e6);
+    }
+    if (t->collect_stats) {
+        print_stats(t, monotonic_ns() - run_start);
+    }
+    round_owner = NULL;
+}
+
+// функция очистки ресурсов турнира
+void cleanup(Tournament* t) {
+    Arena* arena = &t->arena;
+    print_output(t, "Очистка ресурсов.\n");
+    
+    // установка флагов завершения
+    atomic_store(&arena->finished, 1);
+    atomic_store(&arena->round_started, 1);
+    
+    if (t->fighter_threads) {
+        // ожидание завершения всех потоков (они видят finished за один цикл опроса)
+        for (int i = 0; i < t->fighter_count; i++) {
+            if (t->fighter_threads[i]) {
+                pthread_join(t->fighter_threads[i], NULL);
+            }
+        }
+        t->fighter_threads = NULL;
+    }
+    
+    pthread_spin_destroy(&arena->arena_spinlock);  // уничтожение спинлока
+    pthread_mutex_destroy(&t->round_mutex);
+    pthread_cond_destroy(&t->round_cond);
+    if (t->standings.tree) {
+        pthread_spin_destroy(&t->standings.lock);
+        t->standings.tree = NULL;
+    }
+    
+    // массивы турнира живут в пуле и освобождаются одним сбросом
+    memset(&t->duel_log, 0, sizeof(DuelLog));
+    arena->fighters = NULL;
+    arena->ready_fighters = NULL;
+    arena->alive_bits = NULL;
+    arena->duel_bits = NULL;
+    if (t->pool) {
+        pool_reset(t->pool);
+    }
+    
+    sink_close(&t->output_sink);
+    pthread_mutex_destroy(&t->buffer_mutex);  // буфер живет в пуле пакетного режима
+    
+    if (t->record_file) {
+        shutdown_forget_record(t->record_file);
+        fclose(t->record_file);
+        t->record_file = NULL;
+    }
+}
+
+// путь к файлу хранилища
+void store_path(char* path, size_t size, const char* dir, const char* name) {
+    snprintf(path, size, "%s/%s", dir, name);
+}
+
+// запись всего буфера по смещению
+int write_at(int fd, const void* data, size_t len, off_t offset) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+// добавление итогов прогона к накопленным (колонки побед, поражений, ничьих по бойцам)
+void store_fold_run(FighterAggregate* aggregates, const RunRecord* record,
+                    const uint16_t* wins, const uint16_t* losses, const uint16_t* draws) {
+    for (int i = 0; i < record->fighters; i++) {
+        aggregates[i].runs++;
+        aggregates[i].wins += wins[i];
+        aggregates[i].losses += losses[i];
+        aggregates[i].draws += draws[i];
+        aggregates[i].titles += i == record->winner;
+    }
+}
+
+// чтение трех колонок бойцов прогона из его сегмента
+int store_read_columns(int duels_fd, const RunRecord* record, uint16_t* columns) {
+    size_t len = 3 * (size_t)record->fighters * sizeof(uint16_t);
+    off_t offset = record->segment_offset + sizeof(SegmentHeader) +
+                   (off_t)record->duels * (3 * sizeof(int32_t) + sizeof(uint16_t));
+    return pread(duels_fd, columns, len, offset) == (ssize_t)len ? 0 : -1;
+}
+
+// пересборка fighters.agg по первым runs прогонам индекса (под блокировкой хранилища)
+int store_rebuild_aggregates(Tournament* t, int runs_fd, int duels_fd, int agg_fd, int64_t runs) {
+    RunRecord* records = pool_alloc(t->pool, runs * sizeof(RunRecord));
+    if (!records || pread(runs_fd, records, runs * sizeof(RunRecord), 0) !=
+                    (ssize_t)(runs * sizeof(RunRecord))) {
+        return -1;
+    }
+    int max_fighters = 0;
+    for (int64_t id = 0; id < runs; id++) {
+        if (records[id].fighters > max_fighters) {
+            max_fighters = records[id].fighters;
+        }
+    }
+    FighterAggregate* aggregates = pool_alloc(t->pool, (max_fighters + 1) * sizeof(FighterAggregate));
+    uint16_t* columns = pool_alloc(t->pool, 3 * (size_t)max_fighters * sizeof(uint16_t));
+    if (!aggregates || !columns) {
+        return -1;
+    }
+    for (int64_t id = 0; id < runs; id++) {
+        int fighters = records[id].fighters;
+        if (store_read_columns(duels_fd, &records[id], columns) != 0) {
+            return -1;
+        }
+        store_fold_run(aggregates + 1, &records[id], columns, columns + fighters,
+                       columns + 2 * fighters);
+    }
+    
+    // заголовок пишется последним: прерванная пересборка повторится
+    aggregates[0].runs = runs;
+    if (write_at(agg_fd, aggregates + 1, max_fighters * sizeof(FighterAggregate),
+                 sizeof(FighterAggregate)) != 0 ||
+        write_at(agg_fd, aggregates, sizeof(FighterAggregate), 0) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// добавление прогона в хранилище: сегмент колонок, запись индекса, итоги бойцов
+// индекс — точка фиксации => прерванное добавление не видно запросам, отставшие итоги
+// пересобираются следующим добавлением
+int store_append(Tournament* t) {
+    if (!t->store_dir || stop_requested()) {  // прерванный турнир не сохраняется
+        return 0;
+    }
+    char path[1024];
+    mkdir(t->store_dir, 0755);
+    store_path(path, sizeof(path), t->store_dir, "runs.idx");
+    int runs_fd = open(path, O_RDWR | O_CREAT, 0644);
+    store_path(path, sizeof(path), t->store_dir, "duels.col");
+    int duels_fd = open(path, O_RDWR | O_CREAT, 0644);
+    store_path(path, sizeof(path), t->store_dir, "fighters.agg");
+    int agg_fd = open(path, O_RDWR | O_CREAT, 0644);
+    
+    int fighters = t->fighter_count;
+    int duels = atomic_load(&t->duel_log.count);
+    uint16_t* columns = pool_alloc(t->pool, 3 * (size_t)fighters * sizeof(uint16_t));
+    FighterAggregate* aggregates = pool_alloc(t->pool, fighters * sizeof(FighterAggregate));
+    int result = -1;
+    if (runs_fd < 0 || duels_fd < 0 || agg_fd < 0 || !columns || !aggregates) {
+        goto done;
+    }
+    
+    // блокировка хранилища между процессами и турнирами пакетного режима
+    flock(runs_fd, LOCK_EX);
+    struct stat st;
+    fstat(runs_fd, &st);
+    int64_t run_id = st.st_size / (off_t)sizeof(RunRecord);
+    fstat(duels_fd, &st);
+    off_t segment_offset = st.st_size;
+    
+    // колонки по бойцам: победы, поражения, ничьи
+    uint16_t* wins = columns;
+    uint16_t* losses = columns + fighters;
+    uint16_t* draws = columns + 2 * fighters;
+    for (int i = 0; i < duels; i++) {
+        int a = t->duel_log.fighter_a[i];
+        int b = t->duel_log.fighter_b[i];
+        int loser = t->duel_log.winner[i] == a ? b : a;
+        wins[t->duel_log.winner[i]]++;
+        losses[loser]++;
+        draws[a] += t->duel_log.draws[i];
+        draws[b] += t->duel_log.draws[i];
+    }
+    
+    // сегмент: заголовок, 4 колонки боев, 3 колонки бойцов
+    SegmentHeader header = { STORE_MAGIC, (uint32_t)fighters, (uint32_t)duels, 0, run_id };
+    off_t offset = segment_offset;
+    if (write_at(duels_fd, &header, sizeof(header), offset) != 0 ||
+        write_at(duels_fd, t->duel_log.fighter_a, duels * sizeof(int32_t),
+                 offset += sizeof(header)) != 0 ||
+        write_at(duels_fd, t->duel_log.fighter_b, duels * sizeof(int32_t),
+                 offset += duels * sizeof(int32_t)) != 0 ||
+        write_at(duels_fd, t->duel_log.winner, duels * sizeof(int32_t),
+                 offset += duels * sizeof(int32_t)) != 0 ||
+        write_at(duels_fd, t->duel_log.draws, duels * sizeof(uint16_t),
+                 offset += duels * sizeof(int32_t)) != 0 ||
+        write_at(duels_fd, columns, 3 * (size_t)fighters * sizeof(uint16_t),
+                 offset += duels * sizeof(uint16_t)) != 0) {
+        goto unlock;
+    }
+    
+    // запись индекса — точка фиксации: прогон без записи в индексе не существует
+    int winner = first_alive(&t->arena);
+    RunRecord record = { run_id, segment_offset, (int64_t)time(NULL), fighters, duels,
+                         (int32_t)t->seed_base, winner };
+    if (write_at(runs_fd, &record, sizeof(record), run_id * sizeof(RunRecord)) != 0) {
+        goto unlock;
+    }
+    print_output(t, "Результаты записаны в хранилище %s (прогон %lld)\n",
+                 t->store_dir, (long long)run_id);
+    result = 0;
+    
+    // накопленные итоги после индекса; если прошлое добавление прервалось до их записи,
+    // заголовок отстает от индекса и итоги пересобираются по сегментам
+    FighterAggregate header_agg;
+    memset(&header_agg, 0, sizeof(header_agg));
+    if (pread(agg_fd, &header_agg, sizeof(header_agg), 0) < 0) {
+        goto unlock;
+    }
+    if (header_agg.runs != (uint32_t)run_id) {
+        store_rebuild_aggregates(t, runs_fd, duels_fd, agg_fd, run_id + 1);
+        goto unlock;
+    }
+    fstat(agg_fd, &st);
+    size_t known = st.st_size / sizeof(FighterAggregate);
+    known = known > 0 ? known - 1 : 0;
+    size_t to_read = (known < (size_t)fighters ? known : (size_t)fighters) * sizeof(FighterAggregate);
+    if (to_read > 0 && pread(agg_fd, aggregates, to_read, sizeof(FighterAggregate)) != (ssize_t)to_read) {
+        goto unlock;
+    }
+    store_fold_run(aggregates, &record, wins, losses, draws);
+    header_agg.runs = run_id + 1;
+    if (write_at(agg_fd, aggregates, fighters * sizeof(FighterAggregate),
+                 sizeof(FighterAggregate)) == 0) {
+        write_at(agg_fd, &header_agg, sizeof(header_agg), 0);  // заголовок последним
+    }
+    
+unlock:
+    flock(runs_fd, LOCK_UN);
+done:
+    if (result != 0) {
+        print_output(t, "Ошибка записи в хранилище %s\n", t->store_dir);
+    }
+    if (runs_fd >= 0) {
+        close(runs_fd);
+    }
+    if (duels_fd >= 0) {
+        close(duels_fd);
+    }
+    if (agg_fd >= 0) {
+        close(agg_fd);
+    }
+    return result;
+}
+
+// запрос итогов бойца (-query): все прогоны из fighters.agg, последние N — по индексу
+// (если итоги отстают от индекса после прерванного добавления, все прогоны тоже по индексу)
+int run_query(const char* dir, int fighter_id, int last_runs) {
+    char path[1024];
+    if (fighter_id < 0) {
+        printf("Некорректный ID бойца: %d\n", fighter_id);
+        return 1;
     }
     
-    atomic_store(&arena.round_started, 1);  // устанавливаем флаг начала раунда
+    if (last_runs <= 0) {
+        // заголовок итогов и запись бойца
+        store_path(path, sizeof(path), dir, "fighters.agg");
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            perror("Ошибка открытия хранилища");
+            return 1;
+        }
+        FighterAggregate header;
+        FighterAggregate agg;
+        memset(&header, 0, sizeof(header));
+        memset(&agg, 0, sizeof(agg));
+        ssize_t h = pread(fd, &header, sizeof(header), 0);
+        ssize_t n = pread(fd, &agg, sizeof(agg), (off_t)(fighter_id + 1) * sizeof(agg));
+        close(fd);
+        if (h < 0 || (n != 0 && n != (ssize_t)sizeof(agg))) {
+            printf("Ошибка чтения хранилища %s\n", dir);
+            return 1;
+        }
+        struct stat st;
+        store_path(path, sizeof(path), dir, "runs.idx");
+        if (stat(path, &st) == 0 && st.st_size / (off_t)sizeof(RunRecord) != header.runs) {
+            return run_query(dir, fighter_id, INT_MAX);  // итоги отстают: подсчет по сегментам
+        }
+        printf("Боец %d, все прогоны: турниров %u, побед %u, поражений %u, ничьих %u, титулов %u\n",
+               fighter_id, agg.runs, agg.wins, agg.losses, agg.draws, agg.titles);
+        return 0;
+    }
     
-    // сбор активных бойцов без соперника
-    int ready_fighters[MAX_FIGHTERS];
-    int count = 0;
-    for (int i = 0; i < arena.total_count; i++) {
-        if (atomic_load(&arena.fighters[i].active) &&
-            !atomic_load(&arena.fighters[i].has_rival)) {
-            ready_fighters[count++] = i;
+    // последние N прогонов: хвост индекса и три числа из колонок каждого сегмента
+    store_path(path, sizeof(path), dir, "runs.idx");
+    int runs_fd = open(path, O_RDONLY);
+    store_path(path, sizeof(path), dir, "duels.col");
+    int duels_fd = open(path, O_RDONLY);
+    if (runs_fd < 0 || duels_fd < 0) {
+        perror("Ошибка открытия хранилища");
+        if (runs_fd >= 0) {
+            close(runs_fd);
+        }
+        if (duels_fd >= 0) {
+            close(duels_fd);
         }
+        return 1;
     }
     
-    // случайное перемешивание бойцов
-    for (int i = count - 1; i > 0; i--) {
-        int j = rand() % (i + 1);
-        int temp = ready_fighters[i];
-        ready_fighters[i] = ready_fighters[j];
-        ready_fighters[j] = temp;
+    struct stat st;
+    fstat(runs_fd, &st);
+    int64_t total = st.st_size / (off_t)sizeof(RunRecord);
+    int64_t first = total > last_runs ? total - last_runs : 0;
+    long long runs = 0, wins = 0, losses = 0, draws = 0, titles = 0;
+    
+    for (int64_t id = first; id < total; id++) {
+        RunRecord record;
+        if (pread(runs_fd, &record, sizeof(record), id * sizeof(RunRecord)) != sizeof(record)) {
+            break;
+        }
+        if (fighter_id >= record.fighters) {
+            continue;
+        }
+        off_t column = record.segment_offset + sizeof(SegmentHeader) +
+                       (off_t)record.duels * (3 * sizeof(int32_t) + sizeof(uint16_t)) +
+                       (off_t)fighter_id * sizeof(uint16_t);
+        uint16_t values[3];
+        for (int c = 0; c < 3; c++) {
+            if (pread(duels_fd, &values[c], sizeof(uint16_t),
+                      column + (off_t)c * record.fighters * sizeof(uint16_t)) != sizeof(uint16_t)) {
+                values[c] = 0;
+            }
+        }
+        runs++;
+        wins += values[0];
+        losses += values[1];
+        draws += values[2];
+        titles += record.winner == fighter_id;
     }
+    close(runs_fd);
+    close(duels_fd);
     
-    // формирование пар бойцов
-    for (int i = 0; i < count - 1; i += 2) {
-        int fighter1 = ready_fighters[i];
-        int fighter2 = ready_fighters[i + 1];
+    printf("Боец %d, последние %lld прогонов: турниров %lld, побед %lld, поражений %lld, "
+           "ничьих %lld, титулов %lld\n",
+           fighter_id, (long long)(total - first), runs, wins, losses, draws, titles);
+    return 0;
+}
+
+// движок по имени (threads, coro, small); возвращает -1 для неизвестного имени
+int parse_engine(const char* name, EngineType* engine) {
+    if (strcmp(name, "threads") == 0) {
+        *engine = ENGINE_THREADS;
+    } else if (strcmp(name, "coro") == 0) {
+        *engine = ENGINE_CORO;
+    } else if (strcmp(name, "small") == 0) {
+        *engine = ENGINE_SMALL;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// max бойцов для движка
+int engine_max_fighters(EngineType engine) {
+    switch (engine) {
+        case ENGINE_CORO: return MAX_CORO_FIGHTERS;
+        case ENGINE_SMALL: return SMALL_MAX_FIGHTERS;
+        default: return MAX_FIGHTERS;
+    }
+}
+
+// целое поле спецификации, которое должно кончаться пробелом или концом строки;
+// курсор переходит к следующему полю; возвращает -1, если поле не целое число
+int spec_int_field(char** cursor, int* value) {
+    char* end;
+    errno = 0;
+    long parsed = strtol(*cursor, &end, 10);
+    if (end == *cursor || (*end != '\0' && !strchr(" \t\r", *end)) ||
+        errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX) {
+        return -1;
+    }
+    *value = (int)parsed;
+    *cursor = end + strspn(end, " \t\r");
+    return 0;
+}
+
+// разбор следующей спецификации "бойцов [seed] [threads|coro|small]" (под мьютексом)
+// возвращает 0 в конце файла; пустые строки и строки с # пропускаются
+int batch_next_spec(BatchState* b, Tournament* t, int* line_number, int* valid) {
+    while (b->pos < b->size) {
+        // копия строки без перевода строки
+        char line[BATCH_LINE_MAX];
+        size_t len = 0;
+        while (b->pos < b->size && b->data[b->pos] != '\n') {
+            if (len < sizeof(line) - 1) {
+                line[len++] = b->data[b->pos];
+            }
+            b->pos++;
+        }
+        b->pos++;
+        b->line++;
+        line[len] = '\0';
         
-        // атомарная установка флагов соперничества
-        atomic_store(&arena.fighters[fighter1].has_rival, 1);
-        atomic_store(&arena.fighters[fighter1].rival_id, fighter2);
-        atomic_store(&arena.fighters[fighter2].has_rival, 1);
-        atomic_store(&arena.fighters[fighter2].rival_id, fighter1);
+        char* cursor = line + strspn(line, " \t\r");
+        if (*cursor == '\0' || *cursor == '#') {
+            continue;
+        }
         
-        print_output("Организован бой: Боец %d vs Боец %d\n", fighter1, fighter2);
+        tournament_defaults(t);
+        t->top_count = b->options->top_count;
+        t->store_dir = b->options->store_dir;
+        t->strategies = b->options->strategies;
+        t->collect_stats = b->options->collect_stats;
+        t->buffer_output = 1;
+        t->console_echo = 0;
+        *line_number = b->line;
+        *valid = 0;
+        
+        // поля разбираются целиком, как число бойцов в main(): строка должна кончиться
+        // вместе с ними, движок на месте seed или лишний хвост — ошибка спецификации
+        if (spec_int_field(&cursor, &t->fighter_count) != 0) {
+            return 1;
+        }
+        if (*cursor != '\0') {
+            if (spec_int_field(&cursor, &t->custom_seed) != 0) {
+                return 1;
+            }
+            t->use_custom_seed = 1;
+        }
+        if (*cursor != '\0') {
+            char engine_name[16];
+            size_t name_len = strcspn(cursor, " \t\r");
+            if (name_len >= sizeof(engine_name)) {
+                return 1;
+            }
+            memcpy(engine_name, cursor, name_len);
+            engine_name[name_len] = '\0';
+            cursor += name_len + strspn(cursor + name_len, " \t\r");
+            if (parse_engine(engine_name, &t->engine) != 0 || *cursor != '\0') {
+                return 1;
+            }
+        } else {
+            // без движка: малые сетки на потоке пакета, остальные на общем пуле
+            t->engine = t->fighter_count <= SMALL_MAX_FIGHTERS ? ENGINE_SMALL : ENGINE_CORO;
+        }
+        *valid = t->fighter_count >= 2 && t->fighter_count <= engine_max_fighters(t->engine);
+        return 1;
     }
-    
-    atomic_fetch_add(&arena.round_num, 1);  // атомарное увеличение номера раунда
-    print_output("Начало раунда %d. Бойцов готово к бою: %d\n",
-                 atomic_load(&arena.round_num), count);
-    
-    pthread_spin_unlock(&arena.arena_spinlock);  // освобождение спинлока
+    return 0;
 }
 
-// функция потока-бойца
-void* fighter_thread(void* arg) {
-    int fighter_id = *(int*)arg;
-    free(arg);
+// печать готовых выводов по порядку строк (под мьютексом)
+void batch_flush(BatchState* b) {
+    Tournament* options = b->options;
+    while (b->slots[b->next_write % b->window].ready) {
+        BatchSlot* slot = &b->slots[b->next_write % b->window];
+        if (options->console_echo) {
+            fwrite(slot->data, 1, slot->len, stdout);
+        }
+        if (options->use_file_output && options->output_sink.fd >= 0) {
+            sink_write(&options->output_sink, slot->data, slot->len);
+        }
+        free(slot->data);
+        slot->data = NULL;
+        slot->ready = 0;
+        b->next_write++;
+    }
+    pthread_cond_broadcast(&b->slot_cond);
+}
+
+// поток пакетного режима: берет спецификацию, проводит турнир, сдает вывод в окно
+void* batch_runner(void* arg) {
+    BatchState* b = arg;
+    Tournament tournament;
+    Tournament* t = &tournament;
     
-    // инициализация уникального seed для генератора случайных чисел
-    unsigned int seed = time(NULL) + fighter_id + pthread_self();
-    print_output("Боец %d (Поток %lu) начал участие в турнире.\n",
-                 fighter_id, (unsigned long)pthread_self());
+    // пулы живут весь пакет и сбрасываются между турнирами: память выделяется один раз
+    MemoryPool pool;
+    MemoryPool output_pool;
+    if (pool_init(&pool) != 0 || pool_init(&output_pool) != 0) {
+        perror("Ошибка резервирования памяти");
+        pool_destroy(&pool);
+        return NULL;
+    }
     
     while (1) {
-        if (atomic_load(&arena.finished)) {
+        int line_number;
+        int valid;
+        
+        // ограниченное окно: разбор не уходит дальше печати больше чем на window турниров
+        pthread_mutex_lock(&b->mutex);
+        while (b->next_index - b->next_write >= b->window) {
+            pthread_cond_wait(&b->slot_cond, &b->mutex);
+        }
+        if (stop_requested() || !batch_next_spec(b, t, &line_number, &valid)) {
+            pthread_mutex_unlock(&b->mutex);
             break;
         }
+        long long index = b->next_index++;
+        pthread_mutex_unlock(&b->mutex);
+        t->pool = &pool;
+        t->output_pool = &output_pool;
         
-        if (!atomic_load(&arena.fighters[fighter_id].active)) {
-            usleep(10000);
-            continue;
+        print_output(t, "\n=== Турнир %lld (строка %d) ===\n", index + 1, line_number);
+        if (!valid) {
+            print_output(t, "Некорректная спецификация турнира\n");
+            pthread_mutex_destroy(&t->buffer_mutex);
+        } else {
+            if (tournament_setup(t) == 0) {
+                run_tournament(t);
+                store_append(t);
+            } else {
+                valid = 0;
+            }
+            cleanup(t);
         }
         
-        // ожидание начала раунда с timeout
-        int timeout_counter = 10000;
-        while (atomic_load(&arena.round_started) == 0 && 
-            !atomic_load(&arena.finished) && timeout_counter > 0) {
-            usleep(1000);
-            timeout_counter--;
+        // вывод копируется из пула, пул перезаписывается следующим турниром
+        char* data = malloc(t->buffer_len);
+        if (data) {
+            memcpy(data, t->buffer, t->buffer_len);
         }
         
-        if (timeout_counter <= 0 && atomic_load(&arena.round_started) == 0) {
-            print_output("Боец %d: timeout ожидания раунда\n", fighter_id);
-            break;
+        pthread_mutex_lock(&b->mutex);
+        if (!valid) {
+            b->failed++;
         }
-        
-        if (atomic_load(&arena.finished)) {
+        BatchSlot* slot = &b->slots[index % b->window];
+        slot->data = data;
+        slot->len = data ? t->buffer_len : 0;
+        slot->ready = 1;
+        batch_flush(b);
+        pthread_mutex_unlock(&b->mutex);
+    }
+    pool_destroy(&pool);
+    pool_destroy(&output_pool);
+    return NULL;
+}
+
+// пакетный режим (-batch): все турниры файла через один долгоживущий движок
+int run_batch(const char* filename, int parallel, Tournament* options) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Ошибка открытия файла турниров");
+        return 1;
+    }
+    
+    BatchState batch;
+    memset(&batch, 0, sizeof(BatchState));
+    batch.size = (size_t)lseek(fd, 0, SEEK_END);
+    if (batch.size > 0) {
+        batch.data = mmap(NULL, batch.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (batch.data == MAP_FAILED) {
+            perror("Ошибка отображения файла турниров");
+            close(fd);
+            return 1;
+        }
+        madvise((void*)batch.data, batch.size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    
+    batch.options = options;
+    batch.window = parallel * 2;
+    batch.slots = calloc(batch.window, sizeof(BatchSlot));
+    pthread_t* runners = calloc(parallel, sizeof(pthread_t));
+    if (!batch.slots || !runners) {
+        printf("Ошибка выделения памяти для пакетного режима\n");
+        return 1;
+    }
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_cond_init(&batch.slot_cond, NULL);
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int started = 0;
+    for (int i = 0; i < parallel; i++) {
+        if (pthread_create(&runners[i], NULL, batch_runner, &batch) != 0) {
+            perror("Ошибка создания потока пакетного режима");
             break;
         }
-        
-        // если у бойца есть соперник
-        if (atomic_load(&arena.fighters[fighter_id].has_rival)) {
-            int rival_id = atomic_load(&arena.fighters[fighter_id].rival_id);
+        started++;
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(runners[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fflush(stdout);
+    printf("\nПакет %s: турниров %lld, с ошибками %lld, время %.3f с, %.1f турниров/с\n",
+           filename, batch.next_index, batch.failed, seconds,
+           seconds > 0 ? batch.next_index / seconds : 0.0);
+    if (stop_requested()) {
+        printf("Пакет остановлен по сигналу: оставшиеся турниры не запускались\n");
+    }
+    
+    pthread_mutex_destroy(&batch.mutex);
+    pthread_cond_destroy(&batch.slot_cond);
+    free(batch.slots);
+    free(runners);
+    if (batch.size > 0) {
+        munmap((void*)batch.data, batch.size);
+    }
+    return started == parallel && batch.failed == 0 ? 0 : 1;
+}
+
+// состояние проверки записи турнира (массивы выделяются один раз по заголовку)
+typedef struct {
+    int total;  // количество бойцов из заголовка
+    int alive_count;  // количество живых бойцов по результатам боев
+    int round_num;  // номер текущего раунда
+    int seed;  // seed_base турнира из заголовка
+    int fixed_seed;  // seed задан через -seed
+    unsigned char* alive;  // жив ли боец
+    int* rival;  // текущий соперник или -1
+    int* paired_round;  // номер раунда последнего назначения в бой
+    long long duels;  // завершенных боев
+    long long exchanges;  // обменов жестами (включая ничьи)
+    long long draws;  // ничьих
+    long long violations;  // найденных нарушений
+} ReplayState;
+
+ReplayState replay;
+EventRecord replay_buffer[REPLAY_BUFFER_EVENTS];
+
+// регистрация нарушения инварианта
+void replay_violation(long long index, const char* format, ...) {
+    replay.violations++;
+    if (replay.violations > REPLAY_MAX_REPORTS) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    printf("Нарушение (событие %lld): ", index);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+// проверка номера бойца
+int replay_valid_id(int id) {
+    return id >= 0 && id < replay.total;
+}
+
+// проверка одного события записи
+void replay_event(const EventRecord* ev, long long index) {
+    if (ev->type != EV_START && replay.total == 0) {
+        replay_violation(index, "событие до заголовка EV_START");
+        return;
+    }
+    
+    switch (ev->type) {
+        case EV_START:
+            if (replay.total != 0) {
+                replay_violation(index, "повторный заголовок EV_START");
+                return;
+            }
+            if (ev->a < 2 || ev->a > MAX_CORO_FIGHTERS) {
+                replay_violation(index, "некорректное количество бойцов %d", ev->a);
+                return;
+            }
+            replay.alive = malloc(ev->a);
+            replay.rival = malloc(ev->a * sizeof(int));
+            replay.paired_round = malloc(ev->a * sizeof(int));
+            if (!replay.alive || !replay.rival || !replay.paired_round) {
+                replay_violation(index, "нет памяти для %d бойцов", ev->a);
+                return;
+            }
+            replay.total = ev->a;
+            replay.alive_count = ev->a;
+            replay.seed = ev->b;
+            replay.fixed_seed = ev->c;
+            for (int i = 0; i < ev->a; i++) {
+                replay.alive[i] = 1;
+                replay.rival[i] = -1;
+                replay.paired_round[i] = 0;
+            }
+            break;
             
-            // проверка корректности соперника
-            if (rival_id < 0 || rival_id >= arena.total_count ||
-                !atomic_load(&arena.fighters[rival_id].active)) {
-                atomic_store(&arena.fighters[fighter_id].has_rival, 0);
-                atomic_store(&arena.fighters[fighter_id].rival_id, -1);
-                continue;
+        case EV_ROUND:
+            if (ev->a != replay.round_num + 1) {
+                replay_violation(index, "раунд %d после раунда %d", ev->a, replay.round_num);
+            }
+            replay.round_num = ev->a;
+            if (ev->b != replay.alive_count) {
+                replay_violation(index, "раунд %d: alive_count %d, по боям %d",
+                                 ev->a, ev->b, replay.alive_count);
             }
+            break;
             
-            // гарантируем, что бой проводит боец с меньшим ID
-            if (fighter_id > rival_id) {
-                atomic_store(&arena.fighters[fighter_id].has_rival, 0);
-                atomic_store(&arena.fighters[fighter_id].rival_id, -1);
-                continue;
+        case EV_PAIR:
+            if (!replay_valid_id(ev->a) || !replay_valid_id(ev->b) || ev->a == ev->b) {
+                replay_violation(index, "некорректная пара %d vs %d", ev->a, ev->b);
+                return;
+            }
+            for (int k = 0; k < 2; k++) {
+                int f = k == 0 ? ev->a : ev->b;
+                if (!replay.alive[f]) {
+                    replay_violation(index, "выбывший боец %d назначен в бой", f);
+                }
+                if (replay.paired_round[f] == replay.round_num) {
+                    replay_violation(index, "боец %d назначен в бой дважды за раунд %d",
+                                     f, replay.round_num);
+                }
+                if (replay.rival[f] != -1) {
+                    replay_violation(index, "боец %d назначен в бой, не завершив бой с %d",
+                                     f, replay.rival[f]);
+                }
+                replay.paired_round[f] = replay.round_num;
             }
+            replay.rival[ev->a] = ev->b;
+            replay.rival[ev->b] = ev->a;
+            break;
             
-            HandSign my_move;
-            HandSign rival_move;
-            HandSign winner_move;
-            int duel_rounds = 0;
+        case EV_DUEL: {
+            if (!replay_valid_id(ev->a) || !replay_valid_id(ev->b)) {
+                replay_violation(index, "некорректный бой %d vs %d", ev->a, ev->b);
+                return;
+            }
+            if (ev->move1 > PAPER || ev->move2 > PAPER) {
+                replay_violation(index, "некорректный жест в бою %d vs %d", ev->a, ev->b);
+                return;
+            }
+            if (ev->a > ev->b) {
+                replay_violation(index, "бой %d vs %d ведет боец с большим ID", ev->a, ev->b);
+            }
+            if (replay.rival[ev->a] != ev->b || replay.rival[ev->b] != ev->a) {
+                replay_violation(index, "бой %d vs %d не был организован", ev->a, ev->b);
+            }
+            if (!replay.alive[ev->a] || !replay.alive[ev->b]) {
+                replay_violation(index, "в бою %d vs %d участвует выбывший боец", ev->a, ev->b);
+            }
             
-            // цикл боя (повторяется при ничьей)
-            do {
-                duel_rounds++;
-                my_move = rand_r(&seed) % 3;  // генерация жеста бойца
-                rival_move = rand_r(&seed) % 3;   // генерация жеста соперника
-                winner_move = get_winner(my_move, rival_move);
-                
-                print_output("Бой %d vs %d (раунд %d): %s vs %s => ",
-                    fighter_id, rival_id, duel_rounds,
-                    gesture_name(my_move), gesture_name(rival_move));
-                
-                if (winner_move == my_move) {
-                    print_output("Победил Боец %d\n", fighter_id);
-                    // атомарные операции обновления состояния
-                    atomic_fetch_add(&arena.fighters[fighter_id].victories, 1);
-                    atomic_store(&arena.fighters[rival_id].active, 0);
-                    atomic_fetch_sub(&arena.alive_count, 1);
-                } else if (winner_move == rival_move) {
-                    print_output("Победил Боец %d\n", rival_id);
-                    // атомарные операции обновления состояния
-                    atomic_fetch_add(&arena.fighters[rival_id].victories, 1);
-                    atomic_store(&arena.fighters[fighter_id].active, 0);
-                    atomic_fetch_sub(&arena.alive_count, 1);
-                } else {
-                    print_output("Ничья\n");
-                    usleep(300000);  // пауза перед следующим раундом боя
-                }
-            } while (winner_move == (HandSign)-1 &&
-                     atomic_load(&arena.fighters[fighter_id].active) &&
-                     atomic_load(&arena.fighters[rival_id].active));
+            // повторная проверка исхода через get_winner()
+            HandSign winner_move = get_winner((HandSign)ev->move1, (HandSign)ev->move2);
+            int expected = -1;
+            if (winner_move == (HandSign)ev->move1 && ev->move1 != ev->move2) {
+                expected = ev->a;
+            } else if (winner_move == (HandSign)ev->move2 && ev->move1 != ev->move2) {
+                expected = ev->b;
+            }
+            if (expected != ev->c) {
+                replay_violation(index, "бой %d vs %d: %s vs %s, записан исход %d, ожидается %d",
+                                 ev->a, ev->b, gesture_name((HandSign)ev->move1),
+                                 gesture_name((HandSign)ev->move2), ev->c, expected);
+            }
             
-            // сброс флагов соперничества после боя
-            atomic_store(&arena.fighters[fighter_id].has_rival, 0);
-            atomic_store(&arena.fighters[fighter_id].rival_id, -1);
-            atomic_store(&arena.fighters[rival_id].has_rival, 0);
-            atomic_store(&arena.fighters[rival_id].rival_id, -1);
+            replay.exchanges++;
+            if (ev->c == -1) {
+                replay.draws++;
+                break;
+            }
+            if (ev->c != ev->a && ev->c != ev->b) {
+                return;
+            }
+            
+            int loser = ev->c == ev->a ? ev->b : ev->a;
+            if (replay.alive[loser]) {
+                replay.alive[loser] = 0;
+                replay.alive_count--;
+            }
+            replay.rival[ev->a] = -1;
+            replay.rival[ev->b] = -1;
+            replay.duels++;
+            break;
         }
-        
-        usleep(10000);  // пауза для снижения нагрузки на CPU
-    }
-    
-    print_output("Боец %d завершил участие.\n", fighter_id);
-    return NULL;
-}
-
-// функция вывода списка активных бойцов
-void print_active_fighters() {
-    print_output("\nПромежуточные победители: ");
-    int first = 1;
-    for (int i = 0; i < arena.total_count; i++) {
-        if (atomic_load(&arena.fighters[i].active)) {
-            if (!first) {
-                print_output(", ");
+            
+        case EV_FINISH: {
+            int winner = -1;
+            if (replay.alive_count == 1) {
+                for (int i = 0; i < replay.total; i++) {
+                    if (replay.alive[i]) {
+                        winner = i;
+                        break;
+                    }
+                }
             }
-            print_output("Боец %d", i);
-            first = 0;
+            if (ev->a != winner) {
+                replay_violation(index, "записан победитель %d, по боям %d", ev->a, winner);
+            }
+            break;
         }
+            
+        default:
+            replay_violation(index, "неизвестный тип события %d", ev->type);
+            break;
     }
-    print_output("\n");
 }
 
-// функция очистки ресурсов
-void cleanup() {
-    print_output("Очистка ресурсов.\n");
-    
-    // установка флагов завершения
-    atomic_store(&arena.finished, 1);
-    atomic_store(&arena.round_started, 1);
+// режим проверки записанного турнира (-replay)
+int run_replay(const char* filename) {
+    FILE* input = fopen(filename, "rb");
+    if (!input) {
+        perror("Ошибка открытия файла записи");
+        return 1;
+    }
     
-    usleep(100000);  // пауза для завершения потоков
+    memset(&replay, 0, sizeof(replay));
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
     
-    // ожидание завершения всех потоков
-    for (int i = 0; i < fighter_count; i++) {
-        if (fighter_threads[i]) {
-            pthread_join(fighter_threads[i], NULL);
+    // потоковое чтение блоками фиксированного размера
+    long long index = 0;
+    size_t n;
+    while ((n = fread(replay_buffer, sizeof(EventRecord), REPLAY_BUFFER_EVENTS, input)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            replay_event(&replay_buffer[i], index++);
         }
     }
     
-    pthread_spin_destroy(&arena.arena_spinlock);  // уничтожение спинлока
+    int read_error = ferror(input);
+    long tail = ftell(input) % (long)sizeof(EventRecord);
+    fclose(input);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(replay.alive);
+    free(replay.rival);
+    free(replay.paired_round);
     
-    if (output_file) {
-        fclose(output_file);
-        output_file = NULL;
+    if (read_error) {
+        printf("Ошибка чтения файла записи %s\n", filename);
+        return 1;
     }
-}
-
-// обработчик сигналов прерывания
-void signal_handler(int sig) {
-    print_output("\nТурнир остановлен по сигналу %d.\n", sig);
-    cleanup();
-    exit(0);
+    if (tail != 0) {
+        replay_violation(index, "обрезанная запись в конце файла");
+    }
+    
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double megabytes = (double)index * sizeof(EventRecord) / (1024.0 * 1024.0);
+    printf("Проверка записи %s\n", filename);
+    if (replay.total > 0) {
+        printf("Бойцов: %d, seed: %d%s\n", replay.total, replay.seed,
+               replay.fixed_seed ? "" : " (случайный; повтор: -seed с этим значением)");
+    }
+    printf("Событий: %lld, раундов: %d, боев: %lld, обменов: %lld, ничьих: %lld\n",
+           index, replay.round_num, replay.duels, replay.exchanges, replay.draws);
+    printf("Время проверки: %.3f с (%.1f МБ/с)\n",
+           seconds, seconds > 0 ? megabytes / seconds : 0.0);
+    
+    if (replay.violations > 0) {
+        printf("Найдено нарушений: %lld\n", replay.violations);
+        return 1;
+    }
+    printf("Нарушений не найдено.\n");
+    return 0;
 }
 
 // главная функция
 int main(int argc, char *argv[]) {
     char* config_file = NULL;
     char* output_filename = NULL;
+    char* record_filename = NULL;
+    char* batch_filename = NULL;
+    char* query_dir = NULL;
+    int query_fighter = -1;
+    int last_runs = 0;
+    int parallel = BATCH_PARALLEL;
+    int drain_ms = DRAIN_DEFAULT_MS;
     int read_from_file = 0;
-    int custom_seed = 0;
-    int use_custom_seed = 0;
+    int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int engine_chosen = 0;  // движок задан явно (-engine или -workers)
+    Tournament tournament;
+    Tournament* t = &tournament;
+    tournament_defaults(t);
     
     // парсинг аргументов командной строки
     for (int i = 1; i < argc; i++) {
@@ -303,15 +2923,71 @@ int main(int argc, char *argv[]) {
             i++;
         } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
             output_filename = argv[i + 1];
-            use_file_output = 1;
+            t->use_file_output = 1;
+            i++;
+        } else if (strcmp(argv[i], "-top") == 0 && i + 1 < argc) {
+            t->top_count = atoi(argv[i + 1]);  // 0 отключает таблицу лидеров
+            if (t->top_count < 0 || t->top_count > TOP_MAX) {
+                printf("Размер таблицы лидеров должен быть от 0 до %d\n", TOP_MAX);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-quiet") == 0) {
+            t->console_echo = 0;  // вывод только в файл
+        } else if (strcmp(argv[i], "-stats") == 0) {
+            t->collect_stats = 1;  // статистика конкуренции в конце турнира
+        } else if (strcmp(argv[i], "-rec") == 0 && i + 1 < argc) {
+            record_filename = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+            return run_replay(argv[i + 1]);
+        } else if (strcmp(argv[i], "-strategies") == 0 && i + 1 < argc) {
+            if (load_strategies(&t->strategies, argv[i + 1]) != 0) {  // таблица стратегий
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-drain-ms") == 0 && i + 1 < argc) {
+            drain_ms = atoi(argv[i + 1]);  // предел дренажа после сигнала
+            if (drain_ms < 1) {
+                printf("Предел дренажа должен быть не меньше 1 мс\n");
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-store") == 0 && i + 1 < argc) {
+            t->store_dir = argv[i + 1];  // каталог хранилища результатов
+            i++;
+        } else if (strcmp(argv[i], "-query") == 0 && i + 2 < argc) {
+            query_dir = argv[i + 1];  // запрос итогов бойца из хранилища
+            query_fighter = atoi(argv[i + 2]);
+            i += 2;
+        } else if (strcmp(argv[i], "-last") == 0 && i + 1 < argc) {
+            last_runs = atoi(argv[i + 1]);  // только последние N прогонов
+            i++;
+        } else if (strcmp(argv[i], "-batch") == 0 && i + 1 < argc) {
+            batch_filename = argv[i + 1];  // файл спецификаций турниров
+            i++;
+        } else if (strcmp(argv[i], "-parallel") == 0 && i + 1 < argc) {
+            parallel = atoi(argv[i + 1]);  // турниров одновременно в пакетном режиме
             i++;
         } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
-            custom_seed = atoi(argv[i + 1]);
-            use_custom_seed = 1;
+            t->custom_seed = atoi(argv[i + 1]);
+            t->use_custom_seed = 1;
+            i++;
+        } else if (strcmp(argv[i], "-engine") == 0 && i + 1 < argc) {
+            if (parse_engine(argv[i + 1], &t->engine) != 0) {
+                printf("Неизвестный движок: %s (threads, coro или small)\n", argv[i + 1]);
+                return 1;
+            }
+            engine_chosen = 1;
+            i++;
+        } else if (strcmp(argv[i], "-workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[i + 1]);  // количество рабочих потоков включает движок coro
+            t->engine = ENGINE_CORO;
+            engine_chosen = 1;
             i++;
         } else {
             char* endptr;
-            fighter_count = strtol(argv[i], &endptr, 10);
+            t->fighter_count = strtol(argv[i], &endptr, 10);
             if (*endptr != '\0' || endptr == argv[i]) {
                 printf("Некорректный аргумент: %s\n", argv[i]);
                 return 1;
@@ -319,6 +2995,43 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    if (query_dir) {
+        return run_query(query_dir, query_fighter, last_runs);
+    }
+    
+    if (batch_filename) {
+        if (parallel < 1 || workers < 1) {
+            printf("Количество потоков должно быть не меньше 1\n");
+            return 1;
+        }
+        if (record_filename) {
+            printf("Запись событий (-rec) не поддерживается в пакетном режиме\n");
+            return 1;
+        }
+        if (t->use_file_output && output_filename) {
+            if (sink_open(&t->output_sink, output_filename) != 0) {
+                perror("Ошибка открытия файла для вывода");
+                return 1;
+            }
+            printf("Вывод будет сохранен в файл: %s\n", output_filename);
+        }
+        if (shutdown_start(drain_ms, &t->output_sink, NULL) != 0) {
+            perror("Ошибка запуска потока сигналов");
+            return 1;
+        }
+        if (coro_start(workers) != 0) {
+            perror("Ошибка создания рабочего потока");
+            coro_stop();
+            return 1;
+        }
+        coro_pool.collect_stats = t->collect_stats;
+        int result = run_batch(batch_filename, parallel, t);
+        coro_stop();
+        sink_close(&t->output_sink);
+        shutdown_finish();
+        return result;
+    }
+    
     // чтение количества бойцов из файла конфигурации
     if (read_from_file && config_file) {
         FILE* config = fopen(config_file, "r");
@@ -326,139 +3039,87 @@ int main(int argc, char *argv[]) {
             perror("Ошибка открытия файла конфигурации");
             return 1;
         }
-        if (fscanf(config, "%d", &fighter_count) != 1) {
+        if (fscanf(config, "%d", &t->fighter_count) != 1) {
             printf("Ошибка чтения количества бойцов из файла\n");
             fclose(config);
             return 1;
         }
         fclose(config);
-        printf("Прочитано из файла %s: %d бойцов\n", config_file, fighter_count);
-    } else if (fighter_count == 0) {
+        printf("Прочитано из файла %s: %d бойцов\n", config_file, t->fighter_count);
+    } else if (t->fighter_count == 0) {
         return 1;
     }
     
-    // проверка допустимого диапазона количества бойцов
-    if (fighter_count < 2 || fighter_count > MAX_FIGHTERS) {
-        printf("Количество бойцов должно быть от 2 до %d\n", MAX_FIGHTERS);
+    // без явного движка: малая сетка на текущем потоке, остальные на пуле (как в -batch)
+    if (!engine_chosen) {
+        t->engine = t->fighter_count <= SMALL_MAX_FIGHTERS ? ENGINE_SMALL : ENGINE_CORO;
+    }
+    
+    // проверка допустимого диапазона количества бойцов (без -engine — любой из движков)
+    int max_fighters = engine_max_fighters(engine_chosen ? t->engine : ENGINE_CORO);
+    if (t->fighter_count < 2 || t->fighter_count > max_fighters) {
+        printf("Количество бойцов должно быть от 2 до %d\n", max_fighters);
+        return 1;
+    }
+    if (workers < 1) {
+        printf("Количество рабочих потоков должно быть не меньше 1\n");
         return 1;
     }
     
     // открытие файла для вывода результатов
-    if (use_file_output && output_filename) {
-        output_file = fopen(output_filename, "w");
-        if (!output_file) {
+    if (t->use_file_output && output_filename) {
+        if (sink_open(&t->output_sink, output_filename) != 0) {
             perror("Ошибка открытия файла для вывода");
             return 1;
         }
         printf("Вывод будет сохранен в файл: %s\n", output_filename);
     }
     
-    // установка обработчиков сигналов
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-    
-    // инициализация генератора случайных чисел
-    if (use_custom_seed) {
-        srand(custom_seed);
-        print_output("Используется фиксированный seed: %d\n", custom_seed);
-    } else {
-        srand(time(NULL));
-    }
-    
-    print_output("--- Турнир \"Камень-Ножницы-Бумага\" ---\n");
-    print_output("Количество участников: %d\n", fighter_count);
-    
-    // инициализация арены турнира
-    memset(&arena, 0, sizeof(Arena));
-    arena.total_count = fighter_count;
-    atomic_store(&arena.alive_count, fighter_count);
-    atomic_store(&arena.round_num, 0);
-    atomic_store(&arena.finished, 0);
-    atomic_store(&arena.round_started, 0);
-    pthread_spin_init(&arena.arena_spinlock, PTHREAD_PROCESS_PRIVATE);
-    
-    // инициализация бойцов
-    for (int i = 0; i < fighter_count; i++) {
-        arena.fighters[i].id = i;
-        atomic_store(&arena.fighters[i].active, 1);
-        atomic_store(&arena.fighters[i].victories, 0);
-        atomic_store(&arena.fighters[i].has_rival, 0);
-        atomic_store(&arena.fighters[i].rival_id, -1);
-    }
-    
-    print_output("Создание потоков-бойцов...\n");
-    
-    // создание потоков-бойцов
-    for (int i = 0; i < fighter_count; i++) {
-        int* fighter_id = malloc(sizeof(int));
-        *fighter_id = i;
-        if (pthread_create(&fighter_threads[i], NULL, fighter_thread, fighter_id) != 0) {
-            perror("Ошибка создания потока");
-            free(fighter_id);
-            cleanup();
+    // открытие файла для записи событий турнира
+    if (record_filename) {
+        t->record_file = fopen(record_filename, "wb");
+        if (!t->record_file) {
+            perror("Ошибка открытия файла записи");
             return 1;
         }
+        printf("События турнира будут записаны в файл: %s\n", record_filename);
     }
     
-    sleep(2);
-    print_output("\n------ Турнир начинается! ------\n");
-    
-    // главный цикл
-    int round = 0;
-    while (!atomic_load(&arena.finished)) {
-        int active = atomic_load(&arena.alive_count);
-        
-        if (active <= 1) {
-            atomic_store(&arena.finished, 1);
-            break;
-        }
-        
-        print_output("\n--- Раунд %d ---\n", ++round);
-        print_output("Активных бойцов: %d\n", active);
-        
-        atomic_store(&arena.round_started, 0); // сброс флага начала раунда
-        setup_round();  // организация раунда
-        sleep(2);  // пауза между раундами
-        
-        // ожидание завершения всех боев в раунде
-        int duels_active;
-        int max_waits = 30;
-        do {
-            duels_active = 0;
-            for (int i = 0; i < fighter_count; i++) {
-                if (atomic_load(&arena.fighters[i].has_rival)) {
-                    duels_active = 1;
-                    break;
-                }
-            }
-            if (duels_active) {
-                sleep(1);
-                max_waits--;
-            }
-        } while (duels_active && max_waits > 0);
-        
-        print_active_fighters();  // вывод промежуточных результатов
+    // поток сигналов запускается до остальных потоков; отсюда отсчитывается время до первого боя
+    clock_gettime(CLOCK_MONOTONIC, &t->start_time);
+    if (shutdown_start(drain_ms, &t->output_sink, t->record_file) != 0) {
+        perror("Ошибка запуска потока сигналов");
+        return 1;
     }
     
-    atomic_store(&arena.finished, 1);
-    atomic_store(&arena.round_started, 1);
+    if (t->engine == ENGINE_CORO && coro_start(workers) != 0) {
+        perror("Ошибка создания рабочего потока");
+        coro_stop();
+        return 1;
+    }
+    coro_pool.collect_stats = t->collect_stats;
     
-    // определение и вывод победителя
-    int winner_found = 0;
-    for (int i = 0; i < fighter_count; i++) {
-        if (atomic_load(&arena.fighters[i].active)) {
-            print_output("\nТурнир завершен! Победитель: Боец %d\n", i);
-            winner_found = 1;
-            break;
-        }
+    MemoryPool pool;
+    if (pool_init(&pool) != 0) {
+        perror("Ошибка резервирования памяти");
+        coro_stop();
+        return 1;
     }
+    t->pool = &pool;
     
-    if (!winner_found) {
-        print_output("\nТурнир завершен! Победитель не определен.\n");
+    if (tournament_setup(t) != 0) {
+        cleanup(t);
+        coro_stop();
+        pool_destroy(&pool);
+        return 1;
     }
     
-    print_output("Все бои завершены.\n");
-    cleanup();  // очистка ресурсов
+    run_tournament(t);
+    store_append(t);
+    cleanup(t);  // очистка ресурсов
+    coro_stop();
+    pool_destroy(&pool);
+    shutdown_finish();
     
     return 0;
 }